@@ -0,0 +1,507 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include "allocation_tracker.h"
+#include "batch_breaker.h"
+#include "column_stats.h"
+#include "common_utils.h"
+#include "converters.h"
+#include "crib_search.h"
+#include "language_model.h"
+#include "streaming_breaker.h"
+#include "thread_pool.h"
+#include "xor_utils.h"
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+// =======================
+// BENCHMARKS
+// Throughput (MB/s, ops/s) and latency percentiles of every public function
+// of converters.h and xor_utils.h (print helpers excluded) and of the
+// streaming, batch and crib search front ends, over input sizes from 16 B
+// up to 1 GB.
+//
+// Functions with several implementations are measured side by side as
+// variants: library kernel vs scalar reference loop, default thread pool vs
+// serial (SerialScope).
+//
+// Methodology: inputs are deterministic (English sample text encrypted with
+// a fixed key), every case is warmed up first, calls are batched so one
+// sample lasts at least --min-sample-ms, and latency percentiles are taken
+// over repeated samples. --cpu pins the measuring thread to one CPU (Linux);
+// the pool workers are started first and stay unpinned, so "threads" and
+// "serial" variants still differ.
+// Results go to stdout as a table and optionally to a JSON file.
+//=======================
+
+namespace {
+
+    struct Options {
+        std::string filter;
+        uint64_t minSize = 16;
+        uint64_t maxSize = uint64_t{ 16 } << 20;
+        int repetitions = 15;
+        int warmupSamples = 2;
+        double minSampleMs = 1.0;
+        double maxCaseSeconds = 2.0;
+        int cpu = -1;
+        std::string jsonFile;
+        std::string label;
+        bool list = false;
+    };
+
+    // Sizes tried for sized benchmarks: 16 B, 256 B, 4 KB, 64 KB, 1 MB, 16 MB, 256 MB, 1 GB
+    const std::vector<uint64_t> inputSizes = {
+        16, 256, 4096, 65536, uint64_t{ 1 } << 20, uint64_t{ 16 } << 20, uint64_t{ 256 } << 20, uint64_t{ 1 } << 30 };
+
+    const std::string benchmarkKey = "Terminator X: Bring the noise";
+
+    // Keeps the compiler from removing a computation whose result is unused
+    template <typename T>
+    void doNotOptimize(const T& value) {
+#if defined(__GNUC__) || defined(__clang__)
+        asm volatile("" : : "g"(&value) : "memory");
+#else
+        static volatile const void* sink;
+        sink = &value;
+#endif
+    }
+
+    // ==============================
+    // Deterministic inputs of one size, built on first use
+    // ==============================
+    class Inputs {
+    public:
+        explicit Inputs(uint64_t size) : size(size) {}
+
+        const std::string& plaintext() {
+            if (plain.empty() && size > 0) {
+                std::string_view sample = englishSampleText();
+                plain.reserve(size);
+                while (plain.size() < size) plain.append(sample.substr(0, std::min<uint64_t>(sample.size(), size - plain.size())));
+            }
+            return plain;
+        }
+        const std::string& ciphertext() {
+            if (cipher.empty() && size > 0) cipher = XOR_repeatingKeyEncrypt(plaintext(), benchmarkKey);
+            return cipher;
+        }
+        const std::string& hex() {
+            if (hexText.empty() && size > 0) hexText = ascii2hex(ciphertext());
+            return hexText;
+        }
+        const std::string& base64() {
+            if (base64Text.empty() && size > 0) base64Text = ascii2base64(ciphertext());
+            return base64Text;
+        }
+        const std::string& bin() {
+            if (binText.empty() && size > 0) binText = ascii2bin(ciphertext());
+            return binText;
+        }
+        const std::vector<ByteHistogram>& columns() {
+            if (columnHistograms.empty()) columnHistograms = buildColumnHistograms(ciphertext(), static_cast<int>(benchmarkKey.size()));
+            return columnHistograms;
+        }
+        const ByteHistogram& histogram() {
+            if (!histogramReady) {
+                hist = buildHistogram(getColumnView(ciphertext(), 1, 0));
+                histogramReady = true;
+            }
+            return hist;
+        }
+        const KeysizeHistograms& keysizeHistograms() {
+            if (!multiKeysize) {
+                multiKeysize = std::make_unique<KeysizeHistograms>(keysizeRange(2, 40));
+                multiKeysize->append(ciphertext());
+            }
+            return *multiKeysize;
+        }
+
+        const uint64_t size;
+
+    private:
+        std::string plain, cipher, hexText, base64Text, binText;
+        std::vector<ByteHistogram> columnHistograms;
+        ByteHistogram hist{};
+        bool histogramReady = false;
+        std::unique_ptr<KeysizeHistograms> multiKeysize;
+    };
+
+    // Returns the call to measure for inputs of one size
+    using Setup = std::function<std::function<void()>(Inputs&)>;
+
+    struct Benchmark {
+        std::string name;           // function name
+        std::string variant;        // implementation measured
+        bool sized = true;          // false: input size doesn't apply (measured once)
+        uint64_t maxSize = UINT64_MAX;  // largest size that fits in memory / time
+        Setup setup;
+    };
+
+    struct Result {
+        std::string name;
+        std::string variant;
+        uint64_t size = 0;
+        uint64_t iterationsPerSample = 0;
+        size_t samples = 0;
+        double p50 = 0, p90 = 0, p99 = 0, mean = 0;    // ns per call
+        double mbPerSecond = 0;
+        double opsPerSecond = 0;
+        double allocationsPerCall = -1;                 // -1 unless built with XOR_TRACK_ALLOCATIONS
+    };
+
+    constexpr uint64_t binaryStringLimit = uint64_t{ 64 } << 20;      // bit strings are 8x input size
+    constexpr uint64_t perKeyDecodeLimit = uint64_t{ 16 } << 20;      // functions decoding input for all 256 keys
+    constexpr uint64_t lineSplitLimit = uint64_t{ 256 } << 20;        // inputs split into 60-byte line strings
+
+    // ==============================
+    // All benchmarks
+    // ==============================
+    std::vector<Benchmark> allBenchmarks() {
+        const int chi2threshold = 40;
+        const double printableCharTreshhold = 0.7;
+        const int noOfKeysizes = 3;
+        const int keysize = static_cast<int>(benchmarkKey.size());
+        std::vector<Benchmark> b;
+
+        // ---- converters.h ----
+        b.push_back({ "base64ToHex", "library", true, UINT64_MAX, [](Inputs& in) { const std::string& s = in.base64(); return [&s] { doNotOptimize(base64ToHex(s)); }; } });
+        b.push_back({ "base64ToBin", "library", true, binaryStringLimit, [](Inputs& in) { const std::string& s = in.base64(); return [&s] { doNotOptimize(base64ToBin(s)); }; } });
+        b.push_back({ "hex2base64", "library", true, UINT64_MAX, [](Inputs& in) { const std::string& s = in.hex(); return [&s] { doNotOptimize(hex2base64(s)); }; } });
+        b.push_back({ "bin2base64", "library", true, binaryStringLimit, [](Inputs& in) { const std::string& s = in.bin(); return [&s] { doNotOptimize(bin2base64(s)); }; } });
+        b.push_back({ "bin2hex", "library", true, binaryStringLimit, [](Inputs& in) { const std::string& s = in.bin(); return [&s] { doNotOptimize(bin2hex(s)); }; } });
+        b.push_back({ "hex2bin", "library", true, binaryStringLimit, [](Inputs& in) { const std::string& s = in.hex(); return [&s] { doNotOptimize(hex2bin(s)); }; } });
+        b.push_back({ "hex2ascii", "library", true, UINT64_MAX, [](Inputs& in) { const std::string& s = in.hex(); return [&s] { doNotOptimize(hex2ascii(s)); }; } });
+        b.push_back({ "ascii2hex", "library", true, UINT64_MAX, [](Inputs& in) { const std::string& s = in.ciphertext(); return [&s] { doNotOptimize(ascii2hex(s)); }; } });
+        b.push_back({ "bin2ascii", "library", true, binaryStringLimit, [](Inputs& in) { const std::string& s = in.bin(); return [&s] { doNotOptimize(bin2ascii(s)); }; } });
+        b.push_back({ "ascii2bin", "library", true, binaryStringLimit, [](Inputs& in) { const std::string& s = in.ciphertext(); return [&s] { doNotOptimize(ascii2bin(s)); }; } });
+        b.push_back({ "ascii2base64", "library", true, UINT64_MAX, [](Inputs& in) { const std::string& s = in.ciphertext(); return [&s] { doNotOptimize(ascii2base64(s)); }; } });
+        b.push_back({ "base64Toascii", "library", true, UINT64_MAX, [](Inputs& in) { const std::string& s = in.base64(); return [&s] { doNotOptimize(base64Toascii(s)); }; } });
+        b.push_back({ "charbin2base64", "library", false, 0, [](Inputs&) { return [] { doNotOptimize(charbin2base64("010011")); }; } });
+        b.push_back({ "charbin2hex", "library", false, 0, [](Inputs&) { return [] { doNotOptimize(charbin2hex("1011")); }; } });
+        b.push_back({ "charhex2bin", "library", false, 0, [](Inputs&) { return [] { doNotOptimize(charhex2bin('b')); }; } });
+
+        // ---- xor_utils.h: fixed XOR and single-byte analysis ----
+        b.push_back({ "XOR_xorEqualHexString", "library", true, binaryStringLimit, [](Inputs& in) { const std::string& s = in.hex(); return [&s] { doNotOptimize(XOR_xorEqualHexString(s, s)); }; } });
+        b.push_back({ "XOR_xorEqualBinString", "library", true, binaryStringLimit, [](Inputs& in) { const std::string& s = in.bin(); return [&s] { doNotOptimize(XOR_xorEqualBinString(s, s)); }; } });
+        b.push_back({ "XOR_singleByteFreqAnalysis", "library", true, perKeyDecodeLimit, [=](Inputs& in) { const std::string& s = in.hex(); return [=, &s] { doNotOptimize(XOR_singleByteFreqAnalysis(s, chi2threshold, printableCharTreshhold, false, true)); }; } });
+        b.push_back({ "XOR_iterateKeys_str", "library", true, perKeyDecodeLimit, [=](Inputs& in) { const std::string& s = in.ciphertext(); return [=, &s] { doNotOptimize(XOR_iterateKeys_str(s, chi2threshold, printableCharTreshhold, false, true)); }; } });
+        b.push_back({ "XOR_iterateKeys_keys", "library", true, perKeyDecodeLimit, [=](Inputs& in) { const std::string& s = in.ciphertext(); return [=, &s] { doNotOptimize(XOR_iterateKeys_keys(s, chi2threshold, printableCharTreshhold, true)); }; } });
+        b.push_back({ "XOR_iterateKeys_chi2", "library", true, perKeyDecodeLimit, [=](Inputs& in) { const std::string& s = in.ciphertext(); return [=, &s] { doNotOptimize(XOR_iterateKeys_chi2(s, chi2threshold, printableCharTreshhold, true)); }; } });
+        b.push_back({ "XOR_iterateKeys_hist", "library", true, UINT64_MAX, [=](Inputs& in) { const ByteHistogram& h = in.histogram(); return [=, &h] { doNotOptimize(XOR_iterateKeys_hist(h, chi2threshold, printableCharTreshhold, true)); }; } });
+        b.push_back({ "histogramFittingQuotient", "library", false, 0, [](Inputs& in) { const ByteHistogram& h = in.histogram(); return [&h] { doNotOptimize(histogramFittingQuotient(h, 0)); }; } });
+        b.push_back({ "histogramPrintableRatio", "library", false, 0, [](Inputs& in) { const ByteHistogram& h = in.histogram(); return [&h] { doNotOptimize(histogramPrintableRatio(h, 0)); }; } });
+        b.push_back({ "keyConfidence", "library", true, UINT64_MAX, [=](Inputs& in) { const auto& c = in.columns(); return [=, &c] { doNotOptimize(keyConfidence(c, benchmarkKey, printableCharTreshhold)); }; } });
+        b.push_back({ "singleKeyFittingQuotient", "library", true, UINT64_MAX, [](Inputs& in) { const std::string& s = in.plaintext(); return [&s] { doNotOptimize(singleKeyFittingQuotient(s)); }; } });
+        b.push_back({ "singleCharFittingQuotient", "library", false, 0, [](Inputs&) { return [] { doNotOptimize(singleCharFittingQuotient(120, 1000, 'e')); }; } });
+        b.push_back({ "countCharOccurance", "library", true, UINT64_MAX, [](Inputs& in) { const std::string& s = in.plaintext(); return [&s] { doNotOptimize(countCharOccurance(s, 'e')); }; } });
+        b.push_back({ "charFreqTable", "library", false, 0, [](Inputs&) { return [] { doNotOptimize(charFreqTable('e')); }; } });
+
+        // ---- xor_utils.h: repeating-key XOR ----
+        b.push_back({ "XOR_repeatingKeyEncrypt", "kernel", true, UINT64_MAX, [](Inputs& in) { const std::string& s = in.plaintext(); return [&s] { doNotOptimize(XOR_repeatingKeyEncrypt(s, benchmarkKey)); }; } });
+        b.push_back({ "XOR_repeatingKeyEncrypt", "scalar", true, UINT64_MAX, [](Inputs& in) {
+            const std::string& s = in.plaintext();
+            return [&s] {
+                std::string out(s);
+                for (size_t i = 0; i < out.size(); i++) out[i] ^= benchmarkKey[i % benchmarkKey.size()];
+                doNotOptimize(out);
+            };
+            } });
+        b.push_back({ "XOR_breakRepeatingKey", "threads", true, UINT64_MAX, [=](Inputs& in) { const std::string& s = in.ciphertext(); return [=, &s] { doNotOptimize(XOR_breakRepeatingKey(s, chi2threshold, noOfKeysizes, printableCharTreshhold)); }; } });
+        b.push_back({ "XOR_breakRepeatingKey", "serial", true, UINT64_MAX, [=](Inputs& in) { const std::string& s = in.ciphertext(); return [=, &s] { SerialScope serial; doNotOptimize(XOR_breakRepeatingKey(s, chi2threshold, noOfKeysizes, printableCharTreshhold)); }; } });
+        b.push_back({ "XOR_findRepeatingKey", "threads", true, UINT64_MAX, [=](Inputs& in) { const std::string& s = in.ciphertext(); return [=, &s] { doNotOptimize(XOR_findRepeatingKey(s, chi2threshold, noOfKeysizes, printableCharTreshhold)); }; } });
+        b.push_back({ "XOR_findRepeatingKey", "serial", true, UINT64_MAX, [=](Inputs& in) { const std::string& s = in.ciphertext(); return [=, &s] { SerialScope serial; doNotOptimize(XOR_findRepeatingKey(s, chi2threshold, noOfKeysizes, printableCharTreshhold)); }; } });
+        b.push_back({ "XOR_findKeyFromCrib", "crib", true, UINT64_MAX, [](Inputs& in) {
+            const std::string& s = in.ciphertext();
+            BreakerParams params;
+            params.crib = in.plaintext().substr(in.plaintext().size() / 2, benchmarkKey.size() + 16);
+            return [&s, params] { doNotOptimize(XOR_findKeyFromCrib(s, params)); };
+            } });
+
+        // ---- xor_utils.h: breaking building blocks ----
+        b.push_back({ "getHammingDistance", "library", true, UINT64_MAX, [](Inputs& in) { const std::string& s = in.ciphertext(); return [&s] { doNotOptimize(getHammingDistance(s, std::string_view(s).substr(1))); }; } });
+        b.push_back({ "findLikelyKeysizes", "library", true, UINT64_MAX, [](Inputs& in) { const std::string& s = in.ciphertext(); return [&s] { doNotOptimize(findLikelyKeysizes(s, 2, 40, 4, 3)); }; } });
+        b.push_back({ "transposeVector", "library", true, perKeyDecodeLimit, [=](Inputs& in) {
+            auto blocks = std::make_shared<std::vector<std::string>>();
+            const std::string& s = in.ciphertext();
+            for (size_t i = 0; i + keysize <= s.size(); i += keysize) blocks->push_back(s.substr(i, keysize));
+            return [=] { doNotOptimize(transposeVector(*blocks, keysize)); };
+            } });
+        b.push_back({ "getBestKey(histograms)", "library", true, UINT64_MAX, [=](Inputs& in) {
+            const KeysizeHistograms& h = in.keysizeHistograms();
+            return [=, &h] { doNotOptimize(getBestKey(h, { benchmarkKey, benchmarkKey.substr(0, 3) }, printableCharTreshhold)); };
+            } });
+        b.push_back({ "getBestKey(columns)", "library", true, UINT64_MAX, [=](Inputs& in) {
+            auto columns = std::make_shared<std::vector<std::vector<ByteHistogram>>>(1, in.columns());
+            return [=] { doNotOptimize(getBestKey(*columns, { benchmarkKey }, printableCharTreshhold)); };
+            } });
+        b.push_back({ "getBestKey(data)", "library", true, UINT64_MAX, [=](Inputs& in) { const std::string& s = in.ciphertext(); return [=, &s] { doNotOptimize(getBestKey(s, { benchmarkKey, benchmarkKey.substr(0, 3) }, printableCharTreshhold)); }; } });
+        b.push_back({ "plaintextKeyScore", "library", false, 0, [=](Inputs& in) { const ByteHistogram& h = in.histogram(); return [=, &h] { doNotOptimize(plaintextKeyScore(h, printableCharTreshhold)); }; } });
+        b.push_back({ "getKeyForKeysize", "library", true, UINT64_MAX, [=](Inputs& in) { const std::string& s = in.ciphertext(); return [=, &s] { doNotOptimize(getKeyForKeysize(s, keysize, chi2threshold, printableCharTreshhold)); }; } });
+        b.push_back({ "getKeyFromColumnHistograms", "threads", true, UINT64_MAX, [=](Inputs& in) { const auto& c = in.columns(); return [=, &c] { doNotOptimize(getKeyFromColumnHistograms(c, chi2threshold, printableCharTreshhold)); }; } });
+        b.push_back({ "getKeyFromColumnHistograms", "serial", true, UINT64_MAX, [=](Inputs& in) { const auto& c = in.columns(); return [=, &c] { SerialScope serial; doNotOptimize(getKeyFromColumnHistograms(c, chi2threshold, printableCharTreshhold)); }; } });
+        b.push_back({ "getCandidateKeysizes(data)", "library", true, UINT64_MAX, [=](Inputs& in) { const std::string& s = in.ciphertext(); return [=, &s] { doNotOptimize(getCandidateKeysizes(s, noOfKeysizes)); }; } });
+        b.push_back({ "getCandidateKeysizes(histograms)", "library", true, UINT64_MAX, [=](Inputs& in) { const KeysizeHistograms& h = in.keysizeHistograms(); return [=, &h] { doNotOptimize(getCandidateKeysizes(h, noOfKeysizes)); }; } });
+        b.push_back({ "getFullKeyFromGroupedBlocks(data)", "library", true, UINT64_MAX, [=](Inputs& in) { const std::string& s = in.ciphertext(); return [=, &s] { doNotOptimize(getFullKeyFromGroupedBlocks(s, keysize, chi2threshold, noOfKeysizes, printableCharTreshhold)); }; } });
+        b.push_back({ "getFullKeyFromGroupedBlocks(histograms)", "library", true, UINT64_MAX, [=](Inputs& in) { const KeysizeHistograms& h = in.keysizeHistograms(); return [=, &h] { doNotOptimize(getFullKeyFromGroupedBlocks(h, keysize, chi2threshold, printableCharTreshhold)); }; } });
+
+        // ---- streaming_breaker.h ----
+        b.push_back({ "StreamingKeyBreaker", "chunked", true, UINT64_MAX, [](Inputs& in) {
+            const std::string& s = in.ciphertext();
+            return [&s] {
+                StreamingKeyBreaker breaker(2, 40);
+                for (size_t offset = 0; offset < s.size(); offset += 4096) breaker.append(std::string_view(s).substr(offset, 4096));
+                doNotOptimize(breaker.bestKey());
+            };
+            } });
+
+        // ---- batch_breaker.h ----
+        b.push_back({ "breakBatch", "4K jobs", true, UINT64_MAX, [=](Inputs& in) {
+            auto jobs = std::make_shared<std::vector<BatchJob>>();
+            const std::string& s = in.ciphertext();
+            for (size_t offset = 0; offset < s.size(); offset += 4096) {
+                BatchJob job;
+                job.id = std::to_string(jobs->size());
+                job.data = s.substr(offset, 4096);
+                jobs->push_back(std::move(job));
+            }
+            return [=] { doNotOptimize(breakBatch(*jobs, nullptr, chi2threshold, noOfKeysizes, printableCharTreshhold)); };
+            } });
+
+        // ---- crib_search.h ----
+        b.push_back({ "findCribs", "lines", true, lineSplitLimit, [](Inputs& in) {
+            auto lines = std::make_shared<std::vector<std::string>>();
+            const std::string& s = in.ciphertext();
+            for (size_t offset = 0; offset < s.size(); offset += 60) lines->push_back(s.substr(offset, 60));
+            return [=] { doNotOptimize(findCribs(*lines)); };
+            } });
+
+        // Column histograms are the inner loop of most of the above
+        b.push_back({ "buildColumnHistograms", "kernel", true, UINT64_MAX, [=](Inputs& in) { const std::string& s = in.ciphertext(); return [=, &s] { doNotOptimize(buildColumnHistograms(s, keysize)); }; } });
+        b.push_back({ "buildColumnHistograms", "scalar", true, UINT64_MAX, [=](Inputs& in) {
+            const std::string& s = in.ciphertext();
+            return [=, &s] {
+                std::vector<ByteHistogram> columns;
+                for (int c = 0; c < keysize; c++) columns.push_back(buildHistogram(getColumnView(s, keysize, c)));
+                doNotOptimize(columns);
+            };
+            } });
+        return b;
+    }
+
+
+    std::string formatSize(uint64_t size) {
+        if (size >= (uint64_t{ 1 } << 30) && size % (uint64_t{ 1 } << 30) == 0) return std::to_string(size >> 30) + "G";
+        if (size >= (uint64_t{ 1 } << 20) && size % (uint64_t{ 1 } << 20) == 0) return std::to_string(size >> 20) + "M";
+        if (size >= (uint64_t{ 1 } << 10) && size % (uint64_t{ 1 } << 10) == 0) return std::to_string(size >> 10) + "K";
+        return std::to_string(size);
+    }
+
+    Options parseOptions(int argc, char** argv) {
+        Options options;
+        for (int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+            auto value = [&]() -> std::string {
+                if (i + 1 >= argc) throw std::invalid_argument("Missing value for " + arg);
+                return argv[++i];
+            };
+            if (arg == "--filter") options.filter = value();
+            else if (arg == "--min-size") options.minSize = parseSize(value());
+            else if (arg == "--max-size") options.maxSize = parseSize(value());
+            else if (arg == "--repetitions") options.repetitions = std::max(1, std::stoi(value()));
+            else if (arg == "--warmup") options.warmupSamples = std::max(0, std::stoi(value()));
+            else if (arg == "--min-sample-ms") options.minSampleMs = std::stod(value());
+            else if (arg == "--max-case-seconds") options.maxCaseSeconds = std::stod(value());
+            else if (arg == "--cpu") options.cpu = std::stoi(value());
+            else if (arg == "--json") options.jsonFile = value();
+            else if (arg == "--label") options.label = value();
+            else if (arg == "--list") options.list = true;
+            else {
+                std::cout << "Usage: benchmarks [--filter text] [--min-size 16] [--max-size 16M] [--repetitions 15]\n"
+                    "                  [--warmup 2] [--min-sample-ms 1] [--max-case-seconds 2] [--cpu N]\n"
+                    "                  [--json file] [--label text] [--list]\n";
+                std::exit(arg == "--help" ? 0 : 1);
+            }
+        }
+        return options;
+    }
+
+    // Pins the calling thread only, threads it starts later inherit the pin
+    void pinToCpu(int cpu) {
+#if defined(__linux__)
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0) std::cerr << "Warning: Could not pin to CPU " << cpu << "\n";
+#else
+        std::cerr << "Warning: CPU pinning is only supported on Linux\n";
+        (void)cpu;
+#endif
+    }
+
+
+    //=============================================
+    // Measure one benchmark at one size
+    // Note:
+    //      Warmup samples also calibrate calls per sample, so every sample
+    //      lasts at least minSampleMs. Sampling stops after repetitions samples
+    //      or maxCaseSeconds (at least 3 samples are always taken).
+    //=============================================
+
+    Result measure(const Benchmark& benchmark, Inputs& inputs, const Options& options) {
+        using clock = std::chrono::steady_clock;
+        std::function<void()> call = benchmark.setup(inputs);
+
+        auto runSample = [&](uint64_t iterations) {
+            auto start = clock::now();
+            for (uint64_t i = 0; i < iterations; i++) call();
+            return std::chrono::duration<double, std::nano>(clock::now() - start).count();
+        };
+
+        uint64_t iterations = 1;
+        const double minSampleNs = options.minSampleMs * 1e6;
+        for (int w = 0; w < std::max(1, options.warmupSamples); w++) {
+            double ns = runSample(iterations);
+            while (ns < minSampleNs && iterations < (uint64_t{ 1 } << 30)) {
+                iterations = ns > 0 ? std::max<uint64_t>(iterations * 2, static_cast<uint64_t>(iterations * minSampleNs / ns * 1.2)) : iterations * 2;
+                ns = runSample(iterations);
+            }
+        }
+
+        if (allocationTrackingEnabled()) resetAllocationStats();
+        std::vector<double> perCall;
+        const auto caseStart = clock::now();
+        for (int r = 0; r < options.repetitions; r++) {
+            perCall.push_back(runSample(iterations) / iterations);
+            double elapsed = std::chrono::duration<double>(clock::now() - caseStart).count();
+            if (perCall.size() >= 3 && elapsed > options.maxCaseSeconds) break;
+        }
+
+        Result result;
+        result.name = benchmark.name;
+        result.variant = benchmark.variant;
+        result.size = benchmark.sized ? inputs.size : 0;
+        result.iterationsPerSample = iterations;
+        result.samples = perCall.size();
+        if (allocationTrackingEnabled()) {
+            uint64_t allocations = 0;
+            for (int s = 0; s < static_cast<int>(Stage::Count); s++) allocations += stageAllocationStats(static_cast<Stage>(s)).allocations;
+            allocations += unscopedAllocationStats().allocations;
+            result.allocationsPerCall = static_cast<double>(allocations) / (perCall.size() * iterations);
+        }
+
+        std::vector<double> sorted = perCall;
+        std::sort(sorted.begin(), sorted.end());
+        auto percentile = [&](double p) { return sorted[std::min(sorted.size() - 1, static_cast<size_t>(p * (sorted.size() - 1) + 0.5))]; };
+        result.p50 = percentile(0.5);
+        result.p90 = percentile(0.9);
+        result.p99 = percentile(0.99);
+        for (double ns : perCall) result.mean += ns / perCall.size();
+        result.opsPerSecond = result.p50 > 0 ? 1e9 / result.p50 : 0;
+        result.mbPerSecond = result.p50 > 0 ? result.size / result.p50 * 1e9 / (1 << 20) : 0;
+        return result;
+    }
+
+    void printResult(const Result& r) {
+        char line[320];
+        std::snprintf(line, sizeof(line), "%-40s %-8s %6s %12.0f %12.0f %12.0f %12.2f %14.0f",
+            r.name.c_str(), r.variant.c_str(), r.size ? formatSize(r.size).c_str() : "-", r.p50, r.p90, r.p99, r.mbPerSecond, r.opsPerSecond);
+        std::cout << line;
+        if (r.allocationsPerCall >= 0) std::cout << " " << r.allocationsPerCall;
+        std::cout << std::endl;
+    }
+
+    std::string jsonEscape(const std::string& text) {
+        std::string out;
+        for (char c : text) {
+            if (c == '"' || c == '\\') out += '\\';
+            out += c;
+        }
+        return out;
+    }
+
+    void writeJson(const std::string& filename, const Options& options, const std::vector<Result>& results) {
+        std::ofstream file(filename);
+        if (!file.is_open()) {
+            throw std::runtime_error("Error: Could not open file " + filename);
+        }
+        file << "{\"label\":\"" << jsonEscape(options.label) << "\",\"threads\":" << defaultThreadPool().size() + 1
+            << ",\"cpu\":" << options.cpu << ",\"allocation_tracking\":" << (allocationTrackingEnabled() ? "true" : "false") << ",\"results\":[";
+        for (size_t i = 0; i < results.size(); i++) {
+            const Result& r = results[i];
+            file << (i ? ",\n" : "\n") << "{\"name\":\"" << jsonEscape(r.name) << "\",\"variant\":\"" << r.variant << "\",\"size\":" << r.size
+                << ",\"samples\":" << r.samples << ",\"iterations_per_sample\":" << r.iterationsPerSample
+                << ",\"p50_ns\":" << r.p50 << ",\"p90_ns\":" << r.p90 << ",\"p99_ns\":" << r.p99 << ",\"mean_ns\":" << r.mean
+                << ",\"mb_per_s\":" << r.mbPerSecond << ",\"ops_per_s\":" << r.opsPerSecond;
+            if (r.allocationsPerCall >= 0) file << ",\"allocations_per_call\":" << r.allocationsPerCall;
+            file << "}";
+        }
+        file << "\n]}\n";
+    }
+}
+
+
+int main(int argc, char** argv)
+{
+    Options options = parseOptions(argc, argv);
+    std::vector<Benchmark> benchmarks = allBenchmarks();
+
+    if (options.list) {
+        for (const auto& benchmark : benchmarks) std::cout << benchmark.name << " [" << benchmark.variant << "]\n";
+        return 0;
+    }
+    if (options.cpu >= 0) {
+        // Workers start before the pin so they don't share the measuring thread's CPU
+        defaultThreadPool();
+        pinToCpu(options.cpu);
+    }
+
+    char header[320];
+    std::snprintf(header, sizeof(header), "%-40s %-8s %6s %12s %12s %12s %12s %14s",
+        "function", "variant", "size", "p50 ns", "p90 ns", "p99 ns", "MB/s", "ops/s");
+    std::cout << header << (allocationTrackingEnabled() ? " allocs/call" : "") << "\n";
+
+    std::vector<Result> results;
+    std::map<uint64_t, std::unique_ptr<Inputs>> inputs;
+    auto inputsOfSize = [&](uint64_t size) -> Inputs& {
+        auto& slot = inputs[size];
+        if (!slot) slot = std::make_unique<Inputs>(size);
+        return *slot;
+    };
+
+    // Sizes outer, so inputs of one size are built once and freed before the next one
+    std::vector<uint64_t> sizes = { 0 };
+    for (uint64_t size : inputSizes) {
+        if (size >= options.minSize && size <= options.maxSize) sizes.push_back(size);
+    }
+    for (uint64_t size : sizes) {
+        for (const auto& benchmark : benchmarks) {
+            if (!options.filter.empty() && benchmark.name.find(options.filter) == std::string::npos) continue;
+            if (benchmark.sized != (size != 0)) continue;
+            if (benchmark.sized && size > benchmark.maxSize) continue;
+            // unsized benchmarks still get inputs (e.g. a histogram) of the smallest size
+            Inputs& in = inputsOfSize(size ? size : 4096);
+            results.push_back(measure(benchmark, in, options));
+            printResult(results.back());
+        }
+        inputs.clear();
+    }
+
+    if (!options.jsonFile.empty()) writeJson(options.jsonFile, options, results);
+    return 0;
+}
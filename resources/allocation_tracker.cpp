@@ -0,0 +1,208 @@
+#include "allocation_tracker.h"
+#include <atomic>
+#include <cstdio>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <sstream>
+
+namespace {
+    constexpr size_t stageSlots = static_cast<size_t>(Stage::Count);
+    constexpr uint32_t unscopedSlot = static_cast<uint32_t>(Stage::Count);
+
+    struct StageAllocations {
+        std::atomic<uint64_t> allocations{ 0 };
+        std::atomic<uint64_t> frees{ 0 };
+        std::atomic<uint64_t> bytes{ 0 };
+        std::atomic<int64_t> liveBytes{ 0 };
+        std::atomic<int64_t> peakBytes{ 0 };
+    };
+
+    // One slot per stage plus one for allocations outside any scope.
+    // Plain array of atomics: no allocation happens while it is used.
+    StageAllocations slots[stageSlots + 1];
+
+    // Stage of the outermost scope of this thread, unscopedSlot outside scopes
+    thread_local uint32_t currentSlot = unscopedSlot;
+
+    AllocationStats readSlot(const StageAllocations& slot) {
+        AllocationStats stats;
+        stats.allocations = slot.allocations.load(std::memory_order_relaxed);
+        stats.frees = slot.frees.load(std::memory_order_relaxed);
+        stats.bytes = slot.bytes.load(std::memory_order_relaxed);
+        stats.liveBytes = slot.liveBytes.load(std::memory_order_relaxed);
+        stats.peakBytes = slot.peakBytes.load(std::memory_order_relaxed);
+        return stats;
+    }
+
+#ifdef XOR_TRACK_ALLOCATIONS
+    // Stored right in front of every tracked block
+    struct alignas(16) BlockHeader {
+        uint64_t size;
+        uint32_t slot;
+        uint32_t offset;        // distance from start of the underlying allocation to the block
+    };
+    static_assert(sizeof(BlockHeader) == 16, "Header must keep 16-byte alignment of blocks");
+
+    void recordAllocation(uint32_t slot, uint64_t size) {
+        StageAllocations& s = slots[slot];
+        s.allocations.fetch_add(1, std::memory_order_relaxed);
+        s.bytes.fetch_add(size, std::memory_order_relaxed);
+        int64_t live = s.liveBytes.fetch_add(static_cast<int64_t>(size), std::memory_order_relaxed) + static_cast<int64_t>(size);
+        int64_t peak = s.peakBytes.load(std::memory_order_relaxed);
+        while (live > peak && !s.peakBytes.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {
+        }
+    }
+
+    void* trackedAllocate(size_t size, size_t alignment) {
+        const size_t headerSize = alignment > sizeof(BlockHeader) ? alignment : sizeof(BlockHeader);
+        void* raw;
+        if (alignment > sizeof(BlockHeader)) {
+            size_t total = (size + headerSize + alignment - 1) / alignment * alignment;
+            raw = std::aligned_alloc(alignment, total);
+        }
+        else {
+            raw = std::malloc(size + headerSize);
+        }
+        if (raw == nullptr) return nullptr;
+
+        void* block = static_cast<char*>(raw) + headerSize;
+        BlockHeader* header = static_cast<BlockHeader*>(block) - 1;
+        header->size = size;
+        header->slot = currentSlot;
+        header->offset = static_cast<uint32_t>(headerSize);
+        recordAllocation(header->slot, size);
+        return block;
+    }
+
+    void* trackedAllocateOrThrow(size_t size, size_t alignment) {
+        for (;;) {
+            if (void* block = trackedAllocate(size, alignment)) return block;
+            std::new_handler handler = std::get_new_handler();
+            if (handler == nullptr) throw std::bad_alloc();
+            handler();
+        }
+    }
+
+    void trackedFree(void* block) {
+        if (block == nullptr) return;
+        BlockHeader* header = static_cast<BlockHeader*>(block) - 1;
+        StageAllocations& s = slots[header->slot];
+        s.frees.fetch_add(1, std::memory_order_relaxed);
+        s.liveBytes.fetch_sub(static_cast<int64_t>(header->size), std::memory_order_relaxed);
+        std::free(static_cast<char*>(block) - header->offset);
+    }
+#endif
+}
+
+
+//=============================================
+// Allocation scope
+// Takes:
+//      stage - stage allocations of this thread are accounted to
+//=============================================
+
+AllocationScope::AllocationScope(Stage stage) {
+    if (currentSlot == unscopedSlot) {
+        currentSlot = static_cast<uint32_t>(stage);
+        outermost = true;
+    }
+}
+
+AllocationScope::~AllocationScope() {
+    if (outermost) currentSlot = unscopedSlot;
+}
+
+Stage currentAllocationStage() {
+    return static_cast<Stage>(currentSlot);
+}
+
+
+//=============================================
+// Allocation stats
+//=============================================
+
+bool allocationTrackingEnabled() {
+#ifdef XOR_TRACK_ALLOCATIONS
+    return true;
+#else
+    return false;
+#endif
+}
+
+AllocationStats stageAllocationStats(Stage stage) {
+    return readSlot(slots[static_cast<size_t>(stage)]);
+}
+
+AllocationStats unscopedAllocationStats() {
+    return readSlot(slots[unscopedSlot]);
+}
+
+void resetAllocationStats() {
+    for (auto& s : slots) {
+        s.allocations.store(0, std::memory_order_relaxed);
+        s.frees.store(0, std::memory_order_relaxed);
+        s.bytes.store(0, std::memory_order_relaxed);
+        s.liveBytes.store(0, std::memory_order_relaxed);
+        s.peakBytes.store(0, std::memory_order_relaxed);
+    }
+}
+
+
+//=============================================
+// Allocation report
+// Returns:
+//      One line per stage (and "unscoped") with at least one allocation
+//=============================================
+
+std::string allocationReport() {
+    std::ostringstream out;
+    char line[256];
+    std::snprintf(line, sizeof(line), "%-18s %12s %12s %14s %14s %14s\n", "stage", "allocations", "frees", "bytes", "live bytes", "peak bytes");
+    out << line;
+    for (size_t i = 0; i <= stageSlots; i++) {
+        AllocationStats stats = readSlot(slots[i]);
+        if (stats.allocations == 0) continue;
+        std::snprintf(line, sizeof(line), "%-18s %12llu %12llu %14llu %14lld %14lld\n",
+            i == unscopedSlot ? "unscoped" : stageName(static_cast<Stage>(i)),
+            static_cast<unsigned long long>(stats.allocations), static_cast<unsigned long long>(stats.frees),
+            static_cast<unsigned long long>(stats.bytes), static_cast<long long>(stats.liveBytes),
+            static_cast<long long>(stats.peakBytes));
+        out << line;
+    }
+    return out.str();
+}
+
+
+#ifdef XOR_TRACK_ALLOCATIONS
+
+//=============================================
+// Replacement global allocation functions
+// Note:
+//      Every form of operator new / delete has to be replaced, a block from
+//      one replaced form may be released by another (e.g. sized delete)
+//=============================================
+
+void* operator new(size_t size) { return trackedAllocateOrThrow(size, alignof(std::max_align_t)); }
+void* operator new[](size_t size) { return trackedAllocateOrThrow(size, alignof(std::max_align_t)); }
+void* operator new(size_t size, const std::nothrow_t&) noexcept { return trackedAllocate(size, alignof(std::max_align_t)); }
+void* operator new[](size_t size, const std::nothrow_t&) noexcept { return trackedAllocate(size, alignof(std::max_align_t)); }
+void* operator new(size_t size, std::align_val_t alignment) { return trackedAllocateOrThrow(size, static_cast<size_t>(alignment)); }
+void* operator new[](size_t size, std::align_val_t alignment) { return trackedAllocateOrThrow(size, static_cast<size_t>(alignment)); }
+void* operator new(size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept { return trackedAllocate(size, static_cast<size_t>(alignment)); }
+void* operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept { return trackedAllocate(size, static_cast<size_t>(alignment)); }
+
+void operator delete(void* block) noexcept { trackedFree(block); }
+void operator delete[](void* block) noexcept { trackedFree(block); }
+void operator delete(void* block, size_t) noexcept { trackedFree(block); }
+void operator delete[](void* block, size_t) noexcept { trackedFree(block); }
+void operator delete(void* block, const std::nothrow_t&) noexcept { trackedFree(block); }
+void operator delete[](void* block, const std::nothrow_t&) noexcept { trackedFree(block); }
+void operator delete(void* block, std::align_val_t) noexcept { trackedFree(block); }
+void operator delete[](void* block, std::align_val_t) noexcept { trackedFree(block); }
+void operator delete(void* block, size_t, std::align_val_t) noexcept { trackedFree(block); }
+void operator delete[](void* block, size_t, std::align_val_t) noexcept { trackedFree(block); }
+void operator delete(void* block, std::align_val_t, const std::nothrow_t&) noexcept { trackedFree(block); }
+void operator delete[](void* block, std::align_val_t, const std::nothrow_t&) noexcept { trackedFree(block); }
+
+#endif
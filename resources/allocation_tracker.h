@@ -0,0 +1,68 @@
+#ifndef ALLOCATION_TRACKER_H
+#define ALLOCATION_TRACKER_H
+
+#include <cstdint>
+#include <string>
+#include "instrumentation.h"
+
+// ==============================
+// ALLOCATION TRACKER - Heap allocations per pipeline stage
+//
+// Compiled in only with XOR_TRACK_ALLOCATIONS defined: global operator
+// new / delete are then replaced by versions that account every block to
+// the stage of the outermost AllocationScope of the allocating thread.
+// A small header in front of each block remembers its size and stage, so
+// frees are accounted to the stage that allocated the block.
+// Without the flag scopes compile to nothing and all stats stay 0.
+// ==============================
+
+struct AllocationStats {
+    uint64_t allocations = 0;
+    uint64_t frees = 0;         // frees of blocks allocated in the stage (from any stage)
+    uint64_t bytes = 0;         // total bytes requested
+    int64_t liveBytes = 0;      // allocated and not yet freed
+    int64_t peakBytes = 0;      // highest liveBytes since reset
+};
+
+// True if the library was compiled with XOR_TRACK_ALLOCATIONS
+bool allocationTrackingEnabled();
+
+// Stats of a stage, and of allocations made outside any scope
+AllocationStats stageAllocationStats(Stage stage);
+AllocationStats unscopedAllocationStats();
+
+// Stage allocations of the calling thread are accounted to, Stage::Count outside any scope
+Stage currentAllocationStage();
+
+// Zeroes all stats (blocks allocated before the reset and freed after it make liveBytes negative)
+void resetAllocationStats();
+
+// Table of all stages with at least one allocation
+std::string allocationReport();
+
+// Attributes allocations of the calling thread to stage while alive.
+// Nested scopes don't change the stage: a converter called inside the
+// breaking pipeline is accounted to the pipeline stage that called it.
+// ThreadPool::parallelFor opens the caller's stage on the workers it uses.
+class AllocationScope {
+public:
+    explicit AllocationScope(Stage stage);
+    ~AllocationScope();
+
+    AllocationScope(const AllocationScope&) = delete;
+    AllocationScope& operator=(const AllocationScope&) = delete;
+
+private:
+    bool outermost = false;
+};
+
+#define XOR_ALLOCATION_CONCAT_(a, b) a##b
+#define XOR_ALLOCATION_CONCAT(a, b) XOR_ALLOCATION_CONCAT_(a, b)
+
+#ifdef XOR_TRACK_ALLOCATIONS
+#define XOR_ALLOCATION_SCOPE(stage) AllocationScope XOR_ALLOCATION_CONCAT(allocationScope_, __LINE__)(stage)
+#else
+#define XOR_ALLOCATION_SCOPE(stage) ((void)0)
+#endif
+
+#endif // ALLOCATION_TRACKER_H
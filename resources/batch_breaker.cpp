@@ -0,0 +1,115 @@
+#include "batch_breaker.h"
+#include "converters.h"
+#include "thread_pool.h"
+#include "xor_utils.h"
+#include <algorithm>
+#include <chrono>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <mutex>
+#include <numeric>
+#include <optional>
+#include <stdexcept>
+
+//=============================================
+// Load batch job input
+// Takes:
+//      job - batch job
+// Returns:
+//      Ciphertext bytes
+// Throws:
+//      std::runtime_error if the file can't be opened
+//      std::invalid_argument from base64 decoding
+// Note:
+//      Line breaks are removed from base64 input before decoding
+//=============================================
+
+std::string loadBatchJob(const BatchJob& job) {
+    std::string input;
+    if (!job.path.empty()) {
+        std::ifstream file(job.path, std::ios::binary);
+        if (!file.is_open()) {
+            throw std::runtime_error("Error: Could not open file " + job.path);
+        }
+        input.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+    else {
+        input = job.data;
+    }
+
+    if (job.encoding == BatchEncoding::Base64) {
+        input.erase(std::remove_if(input.begin(), input.end(), [](char c) { return c == '\n' || c == '\r'; }), input.end());
+        return base64Toascii(input);
+    }
+    return input;
+}
+
+
+//=============================================
+// Break a batch of ciphertexts
+// Takes:
+//      jobs                  - inputs to break
+//      onResult              - receives result of every job as it completes
+//      chi2threshold         - threshold for Chi^2 filter on key candidates
+//      noOfKeysizes          - number of candidate keysizes to try
+//      printableCharTreshhold - minimum fraction of printable characters required
+// Returns:
+//      Job count, failures, bytes processed and wall-clock time of the batch
+// Note:
+//      Jobs are ordered by input size (file size for files) before they are
+//      handed out. Jobs shorter than parallelJobThreshold run inside a
+//      SerialScope, larger ones use parallel loops of XOR_findRepeatingKey.
+//      An exception thrown by onResult stops the batch and is rethrown.
+//=============================================
+
+BatchStats breakBatch(const std::vector<BatchJob>& jobs, const BatchResultCallback& onResult, int chi2threshold, int noOfKeysizes, double printableCharTreshhold) {
+    const auto start = std::chrono::steady_clock::now();
+
+    std::vector<uint64_t> inputSizes(jobs.size());
+    for (size_t i = 0; i < jobs.size(); i++) {
+        std::error_code error;
+        inputSizes[i] = jobs[i].path.empty() ? jobs[i].data.size() : std::filesystem::file_size(jobs[i].path, error);
+        if (error) inputSizes[i] = 0;
+    }
+    std::vector<size_t> order(jobs.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return inputSizes[a] > inputSizes[b]; });
+
+    BatchStats stats;
+    stats.jobs = jobs.size();
+    std::mutex resultMutex;
+
+    defaultThreadPool().parallelFor(order.size(), [&](size_t n) {
+        const BatchJob& job = jobs[order[n]];
+        BatchResult result;
+        result.id = job.id;
+        uint64_t bytes = 0;
+        try {
+            std::string asciiData = loadBatchJob(job);
+            bytes = asciiData.size();
+
+            std::optional<SerialScope> serial;
+            if (asciiData.size() < parallelJobThreshold) serial.emplace();
+            BreakResult found = XOR_findRepeatingKey(asciiData, chi2threshold, noOfKeysizes, printableCharTreshhold);
+            if (found.key.empty()) {
+                result.error = "No key passed the thresholds";
+            }
+            result.keysize = found.keysize;
+            result.key = found.key;
+            result.confidence = found.confidence;
+        }
+        catch (const std::exception& e) {
+            result.error = e.what();
+        }
+
+        std::lock_guard<std::mutex> lock(resultMutex);
+        stats.bytes += bytes;
+        if (!result.error.empty()) stats.failed++;
+        if (onResult) onResult(result);
+        });
+
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return stats;
+}
@@ -0,0 +1,60 @@
+#ifndef BATCH_BREAKER_H
+#define BATCH_BREAKER_H
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+// ==============================
+// BATCH BREAKER - Repeating-key XOR breaking for many independent ciphertexts
+//
+// Jobs are handed out to the default thread pool largest first, so a big input
+// doesn't start last and stretch the batch. Small inputs are broken on one
+// thread each; large ones split their keysizes and columns between threads,
+// and workers that run out of jobs join those loops.
+// Results are reported through a callback as soon as each job finishes.
+// ==============================
+
+// Inputs at least this long are broken with keysizes and columns in parallel, shorter ones on one thread
+constexpr size_t parallelJobThreshold = 256 * 1024;
+
+// Encoding of a job's file or buffer
+enum class BatchEncoding { Raw, Base64 };
+
+struct BatchJob {
+    std::string id;                             // reported back in the result
+    std::string path;                           // file with the ciphertext, read when not empty
+    std::string data;                           // ciphertext buffer, used when path is empty
+    BatchEncoding encoding = BatchEncoding::Raw;    // base64 files may be split into lines
+};
+
+struct BatchResult {
+    std::string id;
+    int keysize = 0;
+    std::string key;
+    double confidence = 0;
+    std::string error;                          // why the job failed, empty on success
+};
+
+struct BatchStats {
+    size_t jobs = 0;
+    size_t failed = 0;                          // jobs with an error
+    uint64_t bytes = 0;                         // decoded ciphertext bytes of all loaded jobs
+    double seconds = 0;                         // wall-clock time of the whole batch
+
+    double jobsPerSecond() const { return seconds > 0 ? jobs / seconds : 0.0; }
+    double bytesPerSecond() const { return seconds > 0 ? bytes / seconds : 0.0; }
+};
+
+// Called once per job as it completes (never concurrently)
+using BatchResultCallback = std::function<void(const BatchResult&)>;
+
+// Breaks every job (see XOR_findRepeatingKey) and streams results to onResult
+// A job that fails (unreadable file, invalid input) reports an error, the rest of the batch goes on
+BatchStats breakBatch(const std::vector<BatchJob>& jobs, const BatchResultCallback& onResult, int chi2threshold, int noOfKeysizes, double printableCharTreshhold);
+
+// Reads a job's ciphertext from its file or buffer and decodes it
+std::string loadBatchJob(const BatchJob& job);
+
+#endif // BATCH_BREAKER_H
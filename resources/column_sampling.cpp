@@ -0,0 +1,89 @@
+#include "column_sampling.h"
+#include "key_refinement.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+//=============================================
+// Stratified sample column histograms
+// Takes:
+//      data    - ciphertext
+//      keysize - keysize to split data by
+//      model   - byte language model scoring key bytes
+// Returns:
+//      Pooled column histograms of the sample and its significance
+// Note:
+//      Stratum s is data[s * n / S .. (s + 1) * n / S). Round r reads the first
+//      initialStratumSampleBytes * 2^r bytes of every stratum (only the new part
+//      is counted). Per-byte gap of stratum s is
+//      (LL_s(best) - LL_s(runner-up)) / n_s, best and runner-up taken from pooled
+//      histograms; z = mean gap / (standard deviation / sqrt(S)).
+//      Cost depends on the sample size, not on the data length.
+// Throws:
+//      std::invalid_argument if keysize is not positive
+//=============================================
+
+SampledColumnHistograms sampleColumnHistograms(std::string_view data, int keysize, const ByteLanguageModel& model) {
+    if (keysize <= 0) throw std::invalid_argument("Keysize must be positive");
+
+    const size_t strata = sampleStrata;
+    std::vector<std::vector<ByteHistogram>> stratumColumns(strata, std::vector<ByteHistogram>(keysize, ByteHistogram{}));
+    std::vector<size_t> stratumRead(strata, 0);
+
+    SampledColumnHistograms result;
+    result.columns.assign(keysize, ByteHistogram{});
+    for (size_t target = initialStratumSampleBytes;; target *= 2) {
+        // Read next block of every stratum, block byte j belongs to column (offset + j) % keysize
+        bool complete = true;
+        for (size_t s = 0; s < strata; s++) {
+            const size_t begin = s * data.size() / strata;
+            const size_t length = (s + 1) * data.size() / strata - begin;
+            const size_t from = begin + stratumRead[s];
+            const size_t to = begin + std::min(target, length);
+            if (to > from) {
+                std::vector<ByteHistogram> block = buildColumnHistograms(data.substr(from, to - from), keysize);
+                for (int j = 0; j < keysize; j++) {
+                    ByteHistogram& stratumColumn = stratumColumns[s][(from + j) % keysize];
+                    ByteHistogram& pooledColumn = result.columns[(from + j) % keysize];
+                    for (int b = 0; b < 256; b++) {
+                        stratumColumn[b] += block[j][b];
+                        pooledColumn[b] += block[j][b];
+                    }
+                }
+                result.sampledBytes += to - from;
+                stratumRead[s] = to - begin;
+            }
+            if (stratumRead[s] < length) complete = false;
+        }
+
+        // Significance of the weakest column
+        result.minGapZ = std::numeric_limits<double>::infinity();
+        for (int c = 0; c < keysize; c++) {
+            std::vector<int> top = topColumnKeys(result.columns[c], model, 2);
+            double sum = 0, sumSquares = 0;
+            int count = 0;
+            for (size_t s = 0; s < strata; s++) {
+                const uint64_t n = histogramTotal(stratumColumns[s][c]);
+                if (n == 0) continue;
+                double gap = (columnKeyLogLikelihood(stratumColumns[s][c], top[0], model)
+                    - columnKeyLogLikelihood(stratumColumns[s][c], top[1], model)) / n;
+                sum += gap;
+                sumSquares += gap * gap;
+                count++;
+            }
+            double z = 0;
+            if (count >= 2) {
+                double mean = sum / count;
+                double variance = std::max(0.0, (sumSquares - sum * mean) / (count - 1));
+                double standardError = std::sqrt(variance / count);
+                z = standardError > 0 ? mean / standardError : (mean > 0 ? std::numeric_limits<double>::infinity() : 0.0);
+            }
+            result.minGapZ = std::min(result.minGapZ, z);
+        }
+        result.significant = result.minGapZ >= gapSignificanceZ;
+
+        if (result.significant || complete) break;
+    }
+    return result;
+}
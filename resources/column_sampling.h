@@ -0,0 +1,41 @@
+#ifndef COLUMN_SAMPLING_H
+#define COLUMN_SAMPLING_H
+
+#include <cstdint>
+#include <string_view>
+#include <vector>
+#include "column_stats.h"
+#include "language_model.h"
+
+// ==============================
+// COLUMN SAMPLING - Column histograms of huge ciphertexts from a stratified sample
+//
+// A key byte is identified long before its column is read completely. The data
+// is split into equal strata and every round reads the next block of each one.
+// For every column the unigram log-likelihood gap between the best and the
+// runner-up key byte is measured per stratum; the spread of those gaps gives a
+// standard error, and more data is read only while some gap isn't significant.
+// ==============================
+
+// Inputs longer than this are analyzed from a sample instead of full column histograms
+constexpr size_t sampledStatisticsThreshold = size_t{ 16 } << 20;
+
+// Number of strata and bytes read from each of them in the first round (doubled every round)
+constexpr int sampleStrata = 32;
+constexpr size_t initialStratumSampleBytes = 4096;
+
+// Gap between best and runner-up key byte must exceed this many standard errors
+constexpr double gapSignificanceZ = 3.0;
+
+struct SampledColumnHistograms {
+    std::vector<ByteHistogram> columns;     // column histograms pooled over all strata
+    uint64_t sampledBytes = 0;              // bytes read to build them
+    double minGapZ = 0;                     // smallest gap / standard error over all columns
+    bool significant = false;               // minGapZ >= gapSignificanceZ
+};
+
+// Column histograms of keysize from a stratified sample of data, grown until every
+// column's best key byte is significantly ahead of the runner-up (or data is exhausted)
+SampledColumnHistograms sampleColumnHistograms(std::string_view data, int keysize, const ByteLanguageModel& model);
+
+#endif // COLUMN_SAMPLING_H
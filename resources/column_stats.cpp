@@ -0,0 +1,570 @@
+#include "column_stats.h"
+#include "allocation_tracker.h"
+#include "instrumentation.h"
+#include "keysize_kernels.h"
+#include <algorithm>
+#include <memory>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+
+//=============================================
+// Strided column view
+// Takes:
+//      data    - ciphertext
+//      keysize - tested keysize (stride of the view)
+//      column  - column index (0 <= column < keysize)
+// Returns:
+//      View over bytes column, column + keysize, column + 2 * keysize, ...
+// Throws:
+//      std::invalid_argument if keysize or column is out of range
+//=============================================
+
+ColumnView getColumnView(std::string_view data, int keysize, int column) {
+    if (keysize <= 0 || column < 0 || column >= keysize) {
+        throw std::invalid_argument("Invalid keysize or column index");
+    }
+    return ColumnView{ data, static_cast<size_t>(column), static_cast<size_t>(keysize) };
+}
+
+
+//=============================================
+// Column length for given keysize
+// Takes:
+//      dataLength - length of ciphertext
+//      keysize    - tested keysize
+//      column     - column index
+// Returns:
+//      Number of bytes encrypted with key byte [column]
+//=============================================
+
+size_t getColumnLength(size_t dataLength, int keysize, int column) {
+    size_t fullBlocks = dataLength / keysize;
+    return fullBlocks + (static_cast<size_t>(column) < dataLength % keysize ? 1 : 0);
+}
+
+
+//=============================================
+// Histogram of a single column
+// Takes:
+//      column - strided column view
+// Returns:
+//      Occurrence count of each byte value in the column
+//=============================================
+
+ByteHistogram buildHistogram(const ColumnView& column) {
+    ByteHistogram hist{};
+    const size_t len = column.size();
+    for (size_t i = 0; i < len; i++) {
+        hist[static_cast<unsigned char>(column[i])]++;
+    }
+    return hist;
+}
+
+
+//=============================================
+// Histograms of all columns in one pass
+// Takes:
+//      data    - ciphertext
+//      keysize - tested keysize
+// Returns:
+//      Vector of keysize histograms, [i] counts bytes encrypted with key byte i
+// Note:
+//      Every byte of data is read exactly once, keysizes up to
+//      maxFixedKeysize use a kernel specialized for the keysize
+//=============================================
+
+std::vector<ByteHistogram> buildColumnHistograms(std::string_view data, int keysize) {
+    if (keysize <= 0) {
+        throw std::invalid_argument("Keysize must be positive");
+    }
+    std::vector<ByteHistogram> histograms(keysize, ByteHistogram{});
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(data.data());
+    columnHistogramKernel(bytes, data.size(), histograms.data(), keysize, 0);
+    return histograms;
+}
+
+
+//=============================================
+// Materialize all columns of data
+// Takes:
+//      data    - ciphertext
+//      keysize - tested keysize
+// Returns:
+//      Vector of keysize strings, [i] holds bytes encrypted with key byte i
+// Note:
+//      Every column is allocated once at its final size and filled by
+//      the transposition kernel in one pass over data
+//=============================================
+
+std::vector<std::string> transposeColumns(std::string_view data, int keysize) {
+    if (keysize <= 0) {
+        throw std::invalid_argument("Keysize must be positive");
+    }
+    std::vector<std::string> columns(keysize);
+    std::vector<unsigned char*> columnPtrs(keysize);
+    for (int c = 0; c < keysize; c++) {
+        columns[c].resize(getColumnLength(data.size(), keysize, c));
+        columnPtrs[c] = reinterpret_cast<unsigned char*>(columns[c].data());
+    }
+    transposeKernel(reinterpret_cast<const unsigned char*>(data.data()), data.size(), columnPtrs.data(), keysize);
+    return columns;
+}
+
+
+//=============================================
+// Column arena constructor
+// Takes:
+//      data    - ciphertext
+//      keysize - tested keysize
+// Throws:
+//      std::invalid_argument if keysize is not positive
+// Note:
+//      Whole arena is allocated once (data.size() bytes), columns are
+//      written by transposeKernel directly to their final position
+//=============================================
+
+ColumnArena::ColumnArena(std::string_view data, int keysize) : buffer(new char[data.size()]) {
+    if (keysize <= 0) {
+        throw std::invalid_argument("Keysize must be positive");
+    }
+    offsets.resize(keysize + 1);
+    std::vector<unsigned char*> columnPtrs(keysize);
+    offsets[0] = 0;
+    for (int c = 0; c < keysize; c++) {
+        columnPtrs[c] = reinterpret_cast<unsigned char*>(buffer.get()) + offsets[c];
+        offsets[c + 1] = offsets[c] + getColumnLength(data.size(), keysize, c);
+    }
+    transposeKernel(reinterpret_cast<const unsigned char*>(data.data()), data.size(), columnPtrs.data(), keysize);
+}
+
+std::string_view ColumnArena::column(int column) const {
+    if (column < 0 || column >= keysize()) {
+        throw std::invalid_argument("Invalid column index");
+    }
+    return std::string_view(buffer.get() + offsets[column], offsets[column + 1] - offsets[column]);
+}
+
+
+//=============================================
+// Total count of histogram
+// Takes:
+//      hist - byte histogram
+// Returns:
+//      Sum of all byte counts
+//=============================================
+
+uint64_t histogramTotal(const ByteHistogram& hist) {
+    return std::accumulate(hist.begin(), hist.end(), uint64_t{ 0 });
+}
+
+
+//=============================================
+// Plaintext histogram for a key, without decrypting
+// Takes:
+//      columnHistograms - byte histograms of all key columns
+//      key              - candidate key, one byte per column
+// Returns:
+//      Byte histogram of the whole plaintext the key would produce
+// Throws:
+//      std::invalid_argument if key length doesn't match number of columns
+//=============================================
+
+ByteHistogram decodedHistogram(const std::vector<ByteHistogram>& columnHistograms, std::string_view key) {
+    if (key.size() != columnHistograms.size()) {
+        throw std::invalid_argument("Key length doesn't match number of columns");
+    }
+    ByteHistogram plaintext{};
+    for (size_t c = 0; c < key.size(); c++) {
+        const unsigned char k = static_cast<unsigned char>(key[c]);
+        for (size_t b = 0; b < plaintext.size(); b++) {
+            plaintext[b] += columnHistograms[c][b ^ k];
+        }
+    }
+    return plaintext;
+}
+
+
+//=============================================
+// Index of coincidence of a column
+// Takes:
+//      hist - byte histogram of column
+// Returns:
+//      Sum of n_b * (n_b - 1) over all bytes b, divided by N * (N - 1)
+//      (0 for columns shorter than 2 bytes)
+//=============================================
+
+double indexOfCoincidence(const ByteHistogram& hist) {
+    const double total = static_cast<double>(histogramTotal(hist));
+    if (total < 2) return 0.0;
+    double coincidences = 0;
+    for (uint64_t count : hist) {
+        coincidences += static_cast<double>(count) * (static_cast<double>(count) - 1);
+    }
+    return coincidences / (total * (total - 1));
+}
+
+
+//=============================================
+// Average index of coincidence of all columns
+// Takes:
+//      columnHistograms - histograms of all columns of one keysize
+// Returns:
+//      Mean index of coincidence (high for correct keysize, low for wrong one)
+//=============================================
+
+double averageIndexOfCoincidence(const std::vector<ByteHistogram>& columnHistograms) {
+    if (columnHistograms.empty()) return 0.0;
+    double sum = 0;
+    for (const auto& hist : columnHistograms) {
+        sum += indexOfCoincidence(hist);
+    }
+    return sum / columnHistograms.size();
+}
+
+
+//=============================================
+// Range of keysizes
+// Takes:
+//      minKeysize, maxKeysize - inclusive bounds
+// Returns:
+//      Vector {minKeysize, minKeysize + 1, ..., maxKeysize}
+//=============================================
+
+std::vector<int> keysizeRange(int minKeysize, int maxKeysize) {
+    std::vector<int> keysizes;
+    for (int keysize = std::max(minKeysize, 1); keysize <= maxKeysize; keysize++) {
+        keysizes.push_back(keysize);
+    }
+    return keysizes;
+}
+
+
+//=============================================
+// Multi-keysize histograms constructor
+// Takes:
+//      keysizes - set of candidate keysizes (positive, without duplicates)
+// Throws:
+//      std::invalid_argument if keysize set is invalid
+// Note:
+//      Keysizes with a multiple in the set are not counted, each of them
+//      is derived from its smallest counted multiple
+//=============================================
+
+KeysizeHistograms::KeysizeHistograms(const std::vector<int>& keysizes) : keysizeSet(keysizes) {
+    for (size_t i = 0; i < keysizeSet.size(); i++) {
+        if (keysizeSet[i] <= 0) {
+            throw std::invalid_argument("Keysize must be positive");
+        }
+        if (std::find(keysizeSet.begin(), keysizeSet.begin() + i, keysizeSet[i]) != keysizeSet.begin() + i) {
+            throw std::invalid_argument("Duplicate keysize in candidate set");
+        }
+    }
+
+    tables.resize(keysizeSet.size());
+    for (size_t i = 0; i < keysizeSet.size(); i++) {
+        tables[i].keysize = keysizeSet[i];
+        tables[i].columns.assign(keysizeSet[i], ByteHistogram{});
+    }
+
+    // A keysize is counted only if no other keysize in the set is its multiple
+    auto isCounted = [&](int keysize) {
+        for (int other : keysizeSet) {
+            if (other != keysize && other % keysize == 0) return false;
+        }
+        return true;
+    };
+
+    for (auto& t : tables) {
+        if (isCounted(t.keysize)) continue;
+        int bestSource = -1;
+        for (size_t j = 0; j < tables.size(); j++) {
+            if (tables[j].keysize % t.keysize != 0 || !isCounted(tables[j].keysize)) continue;
+            if (bestSource < 0 || tables[j].keysize < tables[bestSource].keysize)
+                bestSource = static_cast<int>(j);
+        }
+        t.source = bestSource;
+    }
+}
+
+
+//=============================================
+// Append chunk of ciphertext
+// Takes:
+//      chunk - next bytes of the ciphertext stream
+// Note:
+//      Chunk is split in blocks of blockSize bytes, every counted keysize
+//      is updated from a block before the next block is read. Derived
+//      keysizes are only marked stale.
+//=============================================
+
+void KeysizeHistograms::append(std::string_view chunk) {
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(chunk.data());
+    for (size_t offset = 0; offset < chunk.size(); offset += blockSize) {
+        size_t len = std::min(blockSize, chunk.size() - offset);
+        countBlock(bytes + offset, len);
+        totalBytes += len;
+    }
+    if (chunk.empty()) return;
+    for (auto& t : tables) {
+        if (t.source >= 0) t.stale = true;
+    }
+}
+
+
+//=============================================
+// Count one block for every counted keysize
+// Takes:
+//      bytes - pointer to block
+//      len   - block length
+//=============================================
+
+void KeysizeHistograms::countBlock(const unsigned char* bytes, size_t len) {
+    for (auto& t : tables) {
+        if (t.source >= 0) continue;
+        size_t startColumn = static_cast<size_t>(totalBytes % t.keysize);   // block continues the stream
+        columnHistogramKernel(bytes, len, t.columns.data(), t.keysize, startColumn);
+    }
+}
+
+
+//=============================================
+// Derive histograms of a divisor keysize from its counted multiple
+// Takes:
+//      t - derived table, summed again from its source
+//=============================================
+
+void KeysizeHistograms::deriveTable(const Table& t) const {
+    const auto& sourceColumns = tables[t.source].columns;
+    for (auto& hist : t.columns) hist.fill(0);
+    for (size_t j = 0; j < sourceColumns.size(); j++) {
+        auto& hist = t.columns[j % t.keysize];
+        for (size_t b = 0; b < hist.size(); b++) {
+            hist[b] += sourceColumns[j][b];
+        }
+    }
+    t.stale = false;
+}
+
+
+//=============================================
+// Find table of given keysize
+// Throws:
+//      std::invalid_argument if keysize is not in the candidate set
+//=============================================
+
+const KeysizeHistograms::Table& KeysizeHistograms::table(int keysize) const {
+    auto it = std::find(keysizeSet.begin(), keysizeSet.end(), keysize);
+    if (it == keysizeSet.end()) {
+        throw std::invalid_argument("Keysize " + std::to_string(keysize) + " is not in the candidate set");
+    }
+    return tables[it - keysizeSet.begin()];
+}
+
+const std::vector<ByteHistogram>& KeysizeHistograms::columns(int keysize) const {
+    const Table& t = table(keysize);
+    if (t.stale) deriveTable(t);
+    return t.columns;
+}
+
+
+namespace {
+
+    // Average index of coincidence of every keysize of the set, in set order
+    std::vector<double> keysizeCoincidences(const KeysizeHistograms& histograms) {
+        std::vector<double> coincidences;
+        coincidences.reserve(histograms.keysizes().size());
+        for (int keysize : histograms.keysizes()) {
+            coincidences.push_back(averageIndexOfCoincidence(histograms.columns(keysize)));
+        }
+        return coincidences;
+    }
+
+    std::vector<int> rankByCoincidence(const std::vector<int>& keysizes, const std::vector<double>& coincidences, int noOfKeys) {
+        struct result {
+            double coincidence;
+            int keyLen;
+        };
+
+        std::vector<result> results;
+        for (size_t i = 0; i < keysizes.size(); i++) {
+            results.push_back({ coincidences[i], keysizes[i] });
+        }
+
+        std::stable_sort(results.begin(), results.end(), [](const result& a, const result& b) {
+            if (a.coincidence != b.coincidence) return a.coincidence > b.coincidence;
+            return a.keyLen < b.keyLen;
+            });
+
+        // A multiple of the real keysize has the same expected IC as the keysize itself,
+        // with short columns noise often ranks it higher. Replace each keysize by its
+        // smallest divisor in the set whose IC is nearly as high.
+        auto coincidenceOf = [&](int keysize) {
+            for (const auto& r : results) {
+                if (r.keyLen == keysize) return r.coincidence;
+            }
+            return 0.0;
+        };
+
+        std::vector<int> finalKeysizes;
+        for (const auto& r : results) {
+            if (finalKeysizes.size() >= static_cast<size_t>(std::max(noOfKeys, 0))) break;
+            int keysize = r.keyLen;
+            for (int d : keysizes) {
+                if (d < keysize && r.keyLen % d == 0 && coincidenceOf(d) >= divisorCoincidenceTolerance * r.coincidence)
+                    keysize = d;
+            }
+            if (std::find(finalKeysizes.begin(), finalKeysizes.end(), keysize) == finalKeysizes.end())
+                finalKeysizes.push_back(keysize);
+        }
+        return finalKeysizes;
+    }
+
+    double marginOf(const std::vector<int>& keysizes, const std::vector<double>& coincidences, int keysize) {
+        const double coincidence = coincidences[std::find(keysizes.begin(), keysizes.end(), keysize) - keysizes.begin()];
+        if (coincidence <= 0) return 0.0;
+        double runnerUp = 0;
+        for (size_t i = 0; i < keysizes.size(); i++) {
+            if (keysizes[i] % keysize == 0 || keysize % keysizes[i] == 0) continue;
+            runnerUp = std::max(runnerUp, coincidences[i]);
+        }
+        return std::clamp(1.0 - runnerUp / coincidence, 0.0, 1.0);
+    }
+
+    // Average index of coincidence of keysize counted straight from data, same value as
+    // averageIndexOfCoincidence(buildColumnHistograms(data, keysize)): every column is walked
+    // twice with one 256-entry counter (count pairs, then clear), no histograms are built
+    double stridedCoincidence(std::string_view data, int keysize) {
+        const unsigned char* bytes = reinterpret_cast<const unsigned char*>(data.data());
+        const size_t stride = static_cast<size_t>(keysize);
+        uint32_t counts[256] = {};
+        double sum = 0;
+        for (size_t column = 0; column < stride; column++) {
+            uint64_t pairs = 0;
+            uint64_t total = 0;
+            for (size_t i = column; i < data.size(); i += stride) {
+                pairs += counts[bytes[i]]++;
+                total++;
+            }
+            for (size_t i = column; i < data.size(); i += stride) counts[bytes[i]] = 0;
+            if (total >= 2) sum += 2.0 * static_cast<double>(pairs) / (static_cast<double>(total) * (total - 1));
+        }
+        return sum / stride;
+    }
+}
+
+
+//=============================================
+// Rank candidate keysizes by index of coincidence
+// Takes:
+//      histograms - multi-keysize histograms of ciphertext
+//      noOfKeys   - number of top keysizes to return
+// Returns:
+//      Vector of likely keysizes (sorted by average IC, highest first)
+// Note:
+//      Ties keep the smaller keysize first. Multiples of the real keysize
+//      score about the same as the keysize itself, so a keysize is replaced
+//      by its smallest divisor with at least divisorCoincidenceTolerance of its IC
+//=============================================
+
+std::vector<int> rankKeysizesByCoincidence(const KeysizeHistograms& histograms, int noOfKeys) {
+    return rankByCoincidence(histograms.keysizes(), keysizeCoincidences(histograms), noOfKeys);
+}
+
+
+//=============================================
+// Separation of keysize from runner-up
+// Takes:
+//      histograms - multi-keysize histograms of ciphertext
+//      keysize    - keysize to rate (must be in the set)
+// Returns:
+//      1 - IC(runner-up) / IC(keysize), clipped to 0-1
+// Note:
+//      Multiples and divisors of keysize are not competitors, they share its
+//      columns (multiples) or are expected to score lower (divisors)
+//=============================================
+
+double keysizeMargin(const KeysizeHistograms& histograms, int keysize) {
+    histograms.columns(keysize);    // throws if keysize is not in the set
+    return marginOf(histograms.keysizes(), keysizeCoincidences(histograms), keysize);
+}
+
+
+//=============================================
+// Adaptive keysize search
+// Takes:
+//      data     - ciphertext
+//      noOfKeys - number of keysizes to return
+//      limits   - keysize range and sample size the search may grow to
+// Returns:
+//      Keysizes ranked by index of coincidence (see rankKeysizesByCoincidence)
+//      and margin of the top one
+// Note:
+//      Starts with keysizes 2..16 over the first 4KB of data. The top keysize is
+//      accepted once it is separated from the runner-up by confidentKeysizeMargin
+//      and none of its multiples up to the largest searchable keysize has a clearly
+//      higher IC (a divisor of the real keysize, 11 for 33, can look well separated).
+//      Until then both the sample and the range are doubled, by default up to
+//      keysize 128 and whole data or 4MB of it (index of coincidence of 128 columns
+//      has long settled by then). Keysizes are only searched while every column
+//      gets at least minCoincidenceColumnLength bytes of sample.
+//      The histograms are kept while the range stays the same, a doubled sample
+//      only appends its new half. IC of every keysize is computed once per round,
+//      multiples beyond the range are counted straight from the sample.
+// Throws:
+//      std::invalid_argument if limits give an empty keysize range or no sample
+//=============================================
+
+KeysizeSearchResult findKeysizesAdaptive(std::string_view data, int noOfKeys, const KeysizeSearchLimits& limits) {
+    const int minKeysize = limits.minKeysize;
+    const int maxKeysize = limits.maxKeysize;
+    const size_t initialSampleSize = std::min<size_t>(4096, limits.maxSampleSize);
+    const size_t maxSampleSize = limits.maxSampleSize;
+    if (minKeysize <= 0 || maxKeysize < minKeysize || maxSampleSize == 0) {
+        throw std::invalid_argument("Invalid keysize search limits");
+    }
+
+    XOR_STAGE_TIMER(Stage::KeysizeDetection);
+
+    XOR_ALLOCATION_SCOPE(Stage::KeysizeDetection);
+    int rangeMax = std::min(std::max(16, minKeysize), maxKeysize);
+    size_t sampleSize = initialSampleSize;
+    std::unique_ptr<KeysizeHistograms> histograms;
+    KeysizeSearchResult result;
+    for (;;) {
+        std::string_view sample = data.substr(0, std::min({ sampleSize, maxSampleSize, data.size() }));
+        const int searchLimit = static_cast<int>(std::min<size_t>(maxKeysize, sample.size() / minCoincidenceColumnLength));
+        const int searchMax = std::min(rangeMax, searchLimit);
+        if (searchMax < minKeysize) return {};
+
+        if (histograms && histograms->keysizes().back() == searchMax) {
+            histograms->append(sample.substr(histograms->size()));
+        }
+        else {
+            histograms = std::make_unique<KeysizeHistograms>(keysizeRange(minKeysize, searchMax));
+            histograms->append(sample);
+        }
+        XOR_STAGE_COUNT(Stage::KeysizeDetection, StageCounter::Bytes, sample.size());
+        const std::vector<int>& keysizes = histograms->keysizes();
+        const std::vector<double> coincidences = keysizeCoincidences(*histograms);
+        result.keysizes = rankByCoincidence(keysizes, coincidences, noOfKeys);
+        if (result.keysizes.empty()) break;
+
+        const int top = result.keysizes.front();
+        result.margin = marginOf(keysizes, coincidences, top);
+        bool confirmed = result.margin >= confidentKeysizeMargin;
+        const double topCoincidence = coincidences[top - minKeysize];
+        for (int multiple = 2 * top; multiple <= searchLimit && confirmed; multiple += top) {
+            const double coincidence = multiple <= searchMax
+                ? coincidences[multiple - minKeysize]
+                : stridedCoincidence(sample, multiple);
+            if (topCoincidence < divisorCoincidenceTolerance * coincidence) confirmed = false;
+        }
+        const bool fullSample = sample.size() == data.size() || sample.size() == maxSampleSize;
+        if (confirmed || (fullSample && searchMax == searchLimit)) break;
+
+        sampleSize *= 2;
+        rangeMax = std::min(2 * rangeMax, maxKeysize);
+    }
+    return result;
+}
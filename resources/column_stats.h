@@ -0,0 +1,169 @@
+#ifndef COLUMN_STATS_H
+#define COLUMN_STATS_H
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// ==============================
+// COLUMN STATS - Per-column statistics for repeating-key XOR analysis
+//
+// A ciphertext encrypted with a key of length keysize splits into keysize
+// "columns": column c holds bytes c, c + keysize, c + 2 * keysize, ...
+// Every byte of a column was XOR-ed with the same key byte.
+//
+// Instead of copying the ciphertext into blocks and transposing them,
+// columns are accessed through strided views or reduced directly to
+// byte histograms in a single pass over the data.
+// ==============================
+
+// Occurrence count of every byte value (indexed by unsigned char)
+using ByteHistogram = std::array<uint64_t, 256>;
+
+// Read-only strided view over one column of a ciphertext (no copying)
+struct ColumnView {
+    std::string_view data;  // whole ciphertext
+    size_t column = 0;      // index of first byte of the column
+    size_t stride = 1;      // distance between consecutive column bytes (== keysize)
+
+    // Number of bytes in the column
+    size_t size() const { return column < data.size() ? (data.size() - column + stride - 1) / stride : 0; }
+
+    // i-th byte of the column
+    char operator[](size_t i) const { return data[column + i * stride]; }
+};
+
+// Returns strided view over given column of data split by keysize
+ColumnView getColumnView(std::string_view data, int keysize, int column);
+
+// Returns number of bytes that fall into given column of data split by keysize
+size_t getColumnLength(size_t dataLength, int keysize, int column);
+
+// Builds byte histogram of a single column view
+ByteHistogram buildHistogram(const ColumnView& column);
+
+// Builds byte histograms of all keysize columns in one pass over data
+// Memory used is proportional to keysize, not to the data length
+std::vector<ByteHistogram> buildColumnHistograms(std::string_view data, int keysize);
+
+// Copies every column of data into its own string (for callers that need contiguous columns)
+std::vector<std::string> transposeColumns(std::string_view data, int keysize);
+
+// ==============================
+// All columns of data materialized in one contiguous buffer (arena):
+// column 0, then column 1, ... Filled by one transposition pass.
+// ==============================
+class ColumnArena {
+public:
+    ColumnArena(std::string_view data, int keysize);
+
+    // Contiguous bytes of given column
+    std::string_view column(int column) const;
+
+    int keysize() const { return static_cast<int>(offsets.size()) - 1; }
+
+private:
+    std::unique_ptr<char[]> buffer;   // not value-initialized, every byte is written by transposition
+    std::vector<size_t> offsets;    // column c is buffer[offsets[c] .. offsets[c + 1])
+};
+
+// Sum of all counts in histogram (== length of the column it was built from)
+uint64_t histogramTotal(const ByteHistogram& hist);
+
+// Histogram of the plaintext produced by decrypting all columns with key (key.size() == number of columns)
+// plaintext[b] = sum over columns c of columns[c][b ^ key[c]], costs O(keysize * 256)
+ByteHistogram decodedHistogram(const std::vector<ByteHistogram>& columnHistograms, std::string_view key);
+
+// Index of coincidence of a column: probability that two bytes picked from it are equal
+// XOR with a constant key byte doesn't change it (~0.065 for English, ~0.004 for random bytes)
+double indexOfCoincidence(const ByteHistogram& hist);
+
+// Average index of coincidence over all columns of one keysize
+double averageIndexOfCoincidence(const std::vector<ByteHistogram>& columnHistograms);
+
+// Returns vector of consecutive keysizes minKeysize..maxKeysize
+std::vector<int> keysizeRange(int minKeysize, int maxKeysize);
+
+// ==============================
+// Column histograms for a whole set of candidate keysizes, filled in one streaming
+// pass over the data. Only keysizes without a multiple in the set are counted,
+// histograms of their divisors are derived by summing columns:
+// column c of keysize d is the sum of columns c, c + d, c + 2d, ... of keysize m (d | m)
+// Derived histograms are summed when they are read, not on every append, so
+// appending costs O(chunk) however small the chunks are. Not thread-safe.
+// ==============================
+class KeysizeHistograms {
+public:
+    explicit KeysizeHistograms(const std::vector<int>& keysizes);
+
+    // Adds next chunk of the ciphertext (chunks are treated as one continuous stream)
+    void append(std::string_view chunk);
+
+    // Column histograms for given keysize (must be one of keysizes()), derived ones are brought up to date first
+    const std::vector<ByteHistogram>& columns(int keysize) const;
+
+    // Candidate keysizes in the order given to constructor
+    const std::vector<int>& keysizes() const { return keysizeSet; }
+
+    // Total number of bytes appended so far
+    uint64_t size() const { return totalBytes; }
+
+private:
+    struct Table {
+        int keysize = 0;
+        int source = -1;                        // index of counted table this one is derived from, -1 if counted
+        mutable std::vector<ByteHistogram> columns;
+        mutable bool stale = false;             // derived table misses bytes appended since it was summed
+    };
+
+    // Bytes of a chunk processed for every counted keysize before moving on,
+    // keeps the block in L1 while each keysize table stays hot in L2
+    static constexpr size_t blockSize = 16 * 1024;
+
+    void countBlock(const unsigned char* bytes, size_t len);
+    void deriveTable(const Table& t) const;
+    const Table& table(int keysize) const;
+
+    std::vector<int> keysizeSet;
+    std::vector<Table> tables;
+    uint64_t totalBytes = 0;
+};
+
+// A keysize stands for its multiple if it has at least this share of the multiple's index of coincidence
+constexpr double divisorCoincidenceTolerance = 0.9;
+
+// Returns [noOfKeys] keysizes with highest average index of coincidence
+std::vector<int> rankKeysizesByCoincidence(const KeysizeHistograms& histograms, int noOfKeys);
+
+// Separation of keysize from its best competitor: 1 - IC(runner-up) / IC(keysize), where runner-up
+// is the best keysize in the set that is neither a multiple nor a divisor of keysize (0 if none is better)
+double keysizeMargin(const KeysizeHistograms& histograms, int keysize);
+
+// Keysize margin at which keysize choice counts as certain
+constexpr double confidentKeysizeMargin = 0.25;
+
+// Adaptive search only tries keysizes whose columns get at least this many bytes of the sample
+constexpr size_t minCoincidenceColumnLength = 12;
+
+// Outcome of adaptive keysize search
+struct KeysizeSearchResult {
+    std::vector<int> keysizes;      // ranked keysizes, best first
+    double margin = 0;              // keysizeMargin of the best one in the last searched range
+};
+
+// Bounds of adaptive keysize search
+struct KeysizeSearchLimits {
+    int minKeysize = 2;
+    int maxKeysize = 128;                       // largest keysize searched
+    size_t maxSampleSize = size_t{ 1 } << 22;   // prefix of data the search reads at most
+};
+
+// Ranks keysizes by index of coincidence, starting with a small keysize range and a prefix sample
+// of data, both widened only until the top keysize is separated from the runner-up and no multiple
+// of it fits clearly better
+KeysizeSearchResult findKeysizesAdaptive(std::string_view data, int noOfKeys, const KeysizeSearchLimits& limits = {});
+
+#endif // COLUMN_STATS_H
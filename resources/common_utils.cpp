@@ -0,0 +1,45 @@
+#include "common_utils.h"
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+
+//=============================================
+// Parse size
+// Takes:
+//      text - number with optional B, K(B), M(B) or G(B) suffix
+// Returns:
+//      Size in bytes (suffixes are powers of 1024)
+// Throws:
+//      std::invalid_argument if text isn't a number or the suffix is unknown
+//=============================================
+
+uint64_t parseSize(const std::string& text) {
+    size_t end = 0;
+    uint64_t value = std::stoull(text, &end);
+    std::string suffix = text.substr(end);
+    if (suffix.empty() || suffix == "B") return value;
+    if (suffix == "K" || suffix == "KB") return value << 10;
+    if (suffix == "M" || suffix == "MB") return value << 20;
+    if (suffix == "G" || suffix == "GB") return value << 30;
+    throw std::invalid_argument("Invalid size: " + text);
+}
+
+
+//=============================================
+// Read file
+// Takes:
+//      filename - path of the file
+// Returns:
+//      File contents, read in binary mode
+// Throws:
+//      std::runtime_error if the file can't be opened
+//=============================================
+
+std::string readFile(const std::string& filename) {
+    std::ifstream file(filename, std::ios::binary);
+    if (!file.is_open()) {
+        throw std::runtime_error("Error: Could not open file " + filename);
+    }
+    return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
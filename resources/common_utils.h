@@ -0,0 +1,35 @@
+#ifndef COMMON_UTILS_H
+#define COMMON_UTILS_H
+
+#include <cstdint>
+#include <string>
+
+// ==============================
+// COMMON UTILITIES - Helpers shared by the library, the tools and the benchmarks
+//
+// SplitMix64 is small, fast and fully specified, so anything seeded with it
+// (generated corpora, word set hashes) is identical on every platform.
+// ==============================
+
+// SplitMix64 output for state x, spreads every input bit over the whole word
+inline uint64_t splitMix64(uint64_t x) {
+    x += 0x9E3779B97F4A7C15ull;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+    return x ^ (x >> 31);
+}
+
+// Next value of the SplitMix64 stream with the given state (advances state)
+inline uint64_t nextSplitMix64(uint64_t& state) {
+    uint64_t value = splitMix64(state);
+    state += 0x9E3779B97F4A7C15ull;
+    return value;
+}
+
+// Size with optional K / M / G suffix (powers of 1024), throws std::invalid_argument on unknown suffix
+uint64_t parseSize(const std::string& text);
+
+// Whole file as bytes, throws std::runtime_error if it can't be opened
+std::string readFile(const std::string& filename);
+
+#endif // COMMON_UTILS_H
@@ -1,7 +1,11 @@
 #include "converters.h"
+#include "allocation_tracker.h"
+#include "instrumentation.h"
+#include "perf_counters.h"
 #include <bitset>
 #include <algorithm>
 #include <cctype>
+#include <cstdint>
 #include <stdexcept>
 
 //=============================================
@@ -14,6 +18,7 @@
 
 std::string base64ToHex(std::string_view base64Str)
 {
+    XOR_ALLOCATION_SCOPE(Stage::Base64Decode);
     std::string binString = base64ToBin(base64Str);
     return bin2hex(binString);
 }
@@ -44,6 +49,7 @@ int base64CharToValue(char c) {
 //=============================================
 
 std::string base64ToBin(std::string_view base64Str) {
+    XOR_ALLOCATION_SCOPE(Stage::Base64Decode);
     size_t len = base64Str.length();
     std::string binString(len * 6, '0');
     for (size_t i = 0; i < len; i++) {
@@ -65,6 +71,7 @@ std::string base64ToBin(std::string_view base64Str) {
 
 std::string hex2base64(std::string_view hexString)
 {
+    XOR_ALLOCATION_SCOPE(Stage::Base64Encode);
     std::string binString = hex2bin(hexString);
     std::string base64String = bin2base64(binString);
     return base64String;
@@ -79,6 +86,7 @@ std::string hex2base64(std::string_view hexString)
 //=============================================
 
 std::string bin2base64(std::string_view binString) {
+    XOR_ALLOCATION_SCOPE(Stage::Base64Encode);
     std::string temp = std::string{ binString };
     std::string base64String;
     if (temp.length() % 6 > 0)
@@ -117,6 +125,7 @@ std::string charbin2base64(std::string_view bin) {
 //=============================================
 
 std::string bin2hex(std::string_view binString) {
+    XOR_ALLOCATION_SCOPE(Stage::HexEncode);
     std::string hexString;
     for (int i = 0; i < binString.length(); i += 4) {
         hexString.append(std::string(1, charbin2hex(binString.substr(i, 4))));
@@ -149,6 +158,7 @@ char charbin2hex(std::string_view charBin) {
 //=============================================
 
 std::string hex2bin(std::string_view hexString) {
+    XOR_ALLOCATION_SCOPE(Stage::HexDecode);
     size_t len = hexString.length();
     std::string binString(len * 4, '0');
     for (size_t i = 0; i < len; i++) {
@@ -197,6 +207,8 @@ std::string charhex2bin(char c) {
 //=============================================
 
 std::string hex2ascii(std::string_view hexStr) {
+    XOR_ALLOCATION_SCOPE(Stage::HexDecode);
+    XOR_PROFILE_KERNEL(Kernel::HexDecode, hexStr.size());
     auto hexCharToInt = [](char c) -> int {
         if (c >= '0' && c <= '9') return c - '0';
         if (c >= 'a' && c <= 'f') return c - 'a' + 10;
@@ -223,6 +235,7 @@ std::string hex2ascii(std::string_view hexStr) {
 //=============================================
 
 std::string ascii2hex(std::string_view asciiStr) {
+    XOR_ALLOCATION_SCOPE(Stage::HexEncode);
     const char* hexChars = "0123456789abcdef";
     size_t len = asciiStr.length();
     std::string hexStr(len * 2, '\0');
@@ -246,6 +259,7 @@ std::string ascii2hex(std::string_view asciiStr) {
 //=============================================
 
 std::string bin2ascii(std::string_view binString) {
+    XOR_ALLOCATION_SCOPE(Stage::BinaryConversion);
     if (binString.size() % 8 != 0) {
         throw std::invalid_argument("String not divisible by 8");
     }
@@ -268,6 +282,7 @@ std::string bin2ascii(std::string_view binString) {
 //=============================================
 
 std::string ascii2bin(std::string_view asciiStr) {
+    XOR_ALLOCATION_SCOPE(Stage::BinaryConversion);
     std::string result;
     result.reserve(asciiStr.size() * 8);
     for (char c : asciiStr) {
@@ -277,6 +292,42 @@ std::string ascii2bin(std::string_view asciiStr) {
 }
 
 
+//=============================================
+// ASCII to Base64 converter
+// Takes:
+//      asciiStr - raw bytes
+// Returns:
+//      Base64 encoded string (with '=' padding)
+// Note:
+//      Encodes 3 bytes to 4 characters directly, without the binary string
+//      round trip of hex2base64
+//=============================================
+
+std::string ascii2base64(std::string_view asciiStr) {
+    XOR_ALLOCATION_SCOPE(Stage::Base64Encode);
+    static const char base64[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(asciiStr.data());
+    size_t len = asciiStr.length();
+    std::string base64String((len + 2) / 3 * 4, '=');
+    size_t out = 0;
+    size_t i = 0;
+    for (; i + 3 <= len; i += 3) {
+        uint32_t triple = (bytes[i] << 16) | (bytes[i + 1] << 8) | bytes[i + 2];
+        base64String[out++] = base64[(triple >> 18) & 0x3F];
+        base64String[out++] = base64[(triple >> 12) & 0x3F];
+        base64String[out++] = base64[(triple >> 6) & 0x3F];
+        base64String[out++] = base64[triple & 0x3F];
+    }
+    if (i < len) {
+        uint32_t triple = (bytes[i] << 16) | (i + 1 < len ? bytes[i + 1] << 8 : 0);
+        base64String[out++] = base64[(triple >> 18) & 0x3F];
+        base64String[out++] = base64[(triple >> 12) & 0x3F];
+        if (i + 1 < len) base64String[out++] = base64[(triple >> 6) & 0x3F];
+    }
+    return base64String;
+}
+
+
 //=============================================
 // Base64 to ASCII converter
 // Takes:
@@ -286,6 +337,10 @@ std::string ascii2bin(std::string_view asciiStr) {
 //=============================================
 
 std::string base64Toascii(std::string_view base64Str) {
+    XOR_ALLOCATION_SCOPE(Stage::Base64Decode);
+    XOR_STAGE_TIMER(Stage::Base64Decode);
+    XOR_STAGE_COUNT(Stage::Base64Decode, StageCounter::Bytes, base64Str.size());
+    XOR_PROFILE_KERNEL(Kernel::Base64Decode, base64Str.size());
     std::string binString = base64ToBin(base64Str);
     size_t totalBits = (base64Str.length() * 6);
     size_t paddingChars = 0;
@@ -45,6 +45,9 @@ std::string bin2ascii(std::string_view binString);
 // Converts an ASCII string into a Binary string (bits as '0' and '1').
 std::string ascii2bin(std::string_view asciiStr);
 
+// Converts an ASCII string directly into a Base64 encoded string.
+std::string ascii2base64(std::string_view asciiStr);
+
 // Converts a Base64 encoded string directly into an ASCII string.
 std::string base64Toascii(std::string_view base64Str);
 
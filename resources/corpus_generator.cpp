@@ -0,0 +1,165 @@
+#include "corpus_generator.h"
+#include <algorithm>
+#include <stdexcept>
+#include <unordered_map>
+#include "common_utils.h"
+#include "keysize_kernels.h"
+
+namespace {
+
+    // Value in [0, n) (modulo bias is negligible for the small n used here)
+    uint64_t randomBelow(uint64_t& state, uint64_t n) {
+        return nextSplitMix64(state) % n;
+    }
+
+    // Key and text streams are seeded apart, so key choices don't shift the text
+    constexpr uint64_t keyStreamSalt = 0x6B65797374726561ull;
+}
+
+
+//=============================================
+// English text generator constructor
+// Takes:
+//      sourceText - text the word chain is trained on
+//      seed       - seed of the word choices
+// Throws:
+//      std::invalid_argument if sourceText contains no words
+// Note:
+//      Words are split on whitespace and keep their punctuation and case,
+//      line breaks are kept as words of their own
+//=============================================
+
+EnglishTextGenerator::EnglishTextGenerator(std::string_view sourceText, uint64_t seed) : rngState(seed) {
+    std::unordered_map<std::string_view, uint32_t> index;
+    std::vector<uint32_t> sequence;
+    auto addWord = [&](std::string_view word) {
+        auto [it, inserted] = index.emplace(word, static_cast<uint32_t>(words.size()));
+        if (inserted) words.emplace_back(word);
+        sequence.push_back(it->second);
+    };
+
+    size_t start = 0;
+    for (size_t i = 0; i <= sourceText.size(); i++) {
+        char c = i < sourceText.size() ? sourceText[i] : ' ';
+        if (c == ' ' || c == '\t' || c == '\r' || c == '\n') {
+            if (i > start) addWord(sourceText.substr(start, i - start));
+            if (c == '\n') addWord("\n");
+            start = i + 1;
+        }
+    }
+    if (words.empty()) {
+        throw std::invalid_argument("Error: Source text contains no words");
+    }
+
+    for (const auto& word : words) {
+        spacedWords.push_back(word == "\n" ? word : " " + word);
+    }
+    followers.resize(words.size());
+    for (size_t i = 0; i + 1 < sequence.size(); i++) {
+        followers[sequence[i]].push_back(sequence[i + 1]);
+    }
+    current = sequence[0];
+    lineStart = words[current] == "\n";
+}
+
+
+//=============================================
+// Pick next word of the chain and queue it for output
+// Note:
+//      A word without followers (end of source) restarts the chain at a random word
+//=============================================
+
+void EnglishTextGenerator::nextWord() {
+    const auto& next = followers[current];
+    current = next.empty() ? static_cast<uint32_t>(randomBelow(rngState, words.size()))
+                           : next[randomBelow(rngState, next.size())];
+    spaced = !lineStart;
+    pendingOffset = 0;
+    lineStart = words[current] == "\n";
+}
+
+
+//=============================================
+// Generate text
+// Takes:
+//      out   - string the text is appended to
+//      bytes - number of characters to append
+//=============================================
+
+void EnglishTextGenerator::generate(std::string& out, size_t bytes) {
+    out.reserve(out.size() + bytes);
+    while (bytes > 0) {
+        if (pendingOffset == (spaced ? spacedWords : words)[current].size()) nextWord();
+        const std::string& word = (spaced ? spacedWords : words)[current];
+        size_t take = std::min(bytes, word.size() - pendingOffset);
+        out.append(word, pendingOffset, take);
+        pendingOffset += take;
+        bytes -= take;
+    }
+}
+
+
+//=============================================
+// Corpus generator constructor
+// Takes:
+//      spec       - corpus size, record size, key lengths and seed
+//      sourceText - text the plaintext generator is trained on
+// Throws:
+//      std::invalid_argument if spec has no key lengths, a key length < 1
+//      or recordBytes == 0
+//=============================================
+
+CorpusGenerator::CorpusGenerator(const CorpusSpec& spec, std::string_view sourceText)
+    : spec(spec), text(sourceText, spec.seed), keyRngState(spec.seed ^ keyStreamSalt) {
+    if (spec.keyLengths.empty() || spec.recordBytes == 0) {
+        throw std::invalid_argument("Corpus spec needs key lengths and a record size");
+    }
+    for (int keyLength : spec.keyLengths) {
+        if (keyLength < 1) throw std::invalid_argument("Invalid key length: " + std::to_string(keyLength));
+    }
+}
+
+
+//=============================================
+// Next piece of the corpus
+// Takes:
+//      piece - filled with plaintext, ciphertext and key of the piece
+// Returns:
+//      false when totalBytes of plaintext were produced (piece is left untouched)
+// Note:
+//      A record longer than corpusPieceBytes is returned in several pieces,
+//      all carrying the same key
+//=============================================
+
+bool CorpusGenerator::next(CorpusPiece& piece) {
+    if (produced >= spec.totalBytes) return false;
+
+    if (recordOffset == 0) {
+        int keyLength = spec.keyLengths[randomBelow(keyRngState, spec.keyLengths.size())];
+        key.resize(keyLength);
+        for (char& k : key) k = static_cast<char>(nextSplitMix64(keyRngState) & 0xFF);
+    }
+
+    uint64_t recordLength = std::min(spec.recordBytes, spec.totalBytes - produced + recordOffset);
+    size_t length = static_cast<size_t>(std::min<uint64_t>(corpusPieceBytes, recordLength - recordOffset));
+
+    piece.record = record;
+    piece.offset = recordOffset;
+    piece.key = key;
+    piece.plaintext.clear();
+    text.generate(piece.plaintext, length);
+    piece.ciphertext.resize(length);
+    size_t shift = static_cast<size_t>(recordOffset % key.size());
+    std::string alignedKey = key.substr(shift) + key.substr(0, shift);
+    repeatingKeyXorKernel(reinterpret_cast<const unsigned char*>(piece.plaintext.data()), reinterpret_cast<unsigned char*>(&piece.ciphertext[0]),
+        length, reinterpret_cast<const unsigned char*>(alignedKey.data()), static_cast<int>(alignedKey.size()));
+
+    produced += length;
+    recordOffset += length;
+    piece.lastOfRecord = recordOffset == recordLength;
+    if (piece.lastOfRecord) {
+        record++;
+        recordOffset = 0;
+    }
+    return true;
+}
@@ -0,0 +1,93 @@
+#ifndef CORPUS_GENERATOR_H
+#define CORPUS_GENERATOR_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "language_model.h"
+
+// ==============================
+// CORPUS GENERATOR - Deterministic synthetic ciphertexts with known keys
+//
+// Plaintext is English-like text produced by a word-bigram chain trained on a
+// source text (by default the embedded English sample). It is split into
+// records, each record is encrypted with its own random key whose length is
+// picked from the given key lengths (1 == single-byte XOR).
+//
+// Output depends only on the spec and the source text: the same seed gives
+// the same bytes on every platform, so benchmarks and accuracy tests can be
+// reproduced. Records are produced in pieces of bounded size, so corpora of
+// any size are generated with constant memory.
+// ==============================
+
+// Pieces are multiples of 3 bytes, so each piece base64-encodes without padding
+constexpr size_t corpusPieceBytes = 3 << 20;
+
+struct CorpusSpec {
+    uint64_t seed = 1;
+    uint64_t totalBytes = 1 << 20;              // plaintext bytes of all records together
+    uint64_t recordBytes = 4096;                // plaintext bytes per record (the last one may be shorter)
+    std::vector<int> keyLengths = { 1 };        // key length of each record is picked uniformly from these
+};
+
+// Consecutive part of one record
+struct CorpusPiece {
+    uint64_t record = 0;                        // index of the record
+    uint64_t offset = 0;                        // position of the piece in its record
+    std::string key;                            // key of the record (ground truth)
+    std::string plaintext;
+    std::string ciphertext;                     // plaintext XOR key, key aligned to the record start
+    bool lastOfRecord = false;
+};
+
+// ==============================
+// English-like text from a word-bigram chain: every word is followed by
+// a word that followed it somewhere in the source text
+// ==============================
+class EnglishTextGenerator {
+public:
+    // Throws if sourceText has no words
+    EnglishTextGenerator(std::string_view sourceText, uint64_t seed);
+
+    // Appends exactly bytes characters of text to out (text continues across calls)
+    void generate(std::string& out, size_t bytes);
+
+private:
+    void nextWord();
+
+    std::vector<std::string> words;             // distinct words of the source, "\n" included
+    std::vector<std::string> spacedWords;       // same words with a leading space (used within a line)
+    std::vector<std::vector<uint32_t>> followers;   // indices of words that followed each word (with repeats)
+    uint32_t current = 0;
+    bool spaced = false;                        // current word is output from spacedWords
+    size_t pendingOffset = 0;                   // bytes of the current word already output
+    bool lineStart = true;
+    uint64_t rngState;
+};
+
+// ==============================
+// Splits generated text into records and encrypts them
+// ==============================
+class CorpusGenerator {
+public:
+    // Throws if the spec has no key lengths, a key length < 1 or recordBytes == 0
+    explicit CorpusGenerator(const CorpusSpec& spec, std::string_view sourceText = englishSampleText());
+
+    // Fills piece with the next part of the corpus, returns false when the corpus is complete
+    bool next(CorpusPiece& piece);
+
+    // Plaintext bytes produced so far
+    uint64_t generatedBytes() const { return produced; }
+
+private:
+    CorpusSpec spec;
+    EnglishTextGenerator text;
+    uint64_t keyRngState;
+    uint64_t produced = 0;
+    uint64_t record = 0;
+    uint64_t recordOffset = 0;
+    std::string key;
+};
+
+#endif // CORPUS_GENERATOR_H
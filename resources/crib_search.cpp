@@ -0,0 +1,204 @@
+#include "crib_search.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <deque>
+#include <stdexcept>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define CRIB_SEARCH_SSE2 1
+#endif
+
+//=============================================
+// Default cribs
+// Returns:
+//      Frequent English words and endings with the spaces around them
+//      (5 bytes or less, so they fit short lines)
+//=============================================
+
+const std::vector<std::string>& defaultCribs() {
+    static const std::vector<std::string> cribs = {
+        " the ", "ing ", ", and", " and ", " of ", " to ", " is ", "The ", "tion"
+    };
+    return cribs;
+}
+
+
+//=============================================
+// Compile crib automaton
+// Takes:
+//      cribs - plaintext words to search for
+// Throws:
+//      std::invalid_argument if a crib has fewer than 2 bytes (a single
+//      byte has no difference and matches under every key)
+// Note:
+//      Trie of crib differences, then breadth-first pass that sets the
+//      failure transitions: a missing transition of state s goes where the
+//      same byte leads from the failure state of s, which is shallower and
+//      already complete. Outputs of the failure state are added to s, so a
+//      crib ending inside a longer one is reported too.
+//=============================================
+
+CribMatcher::CribMatcher(const std::vector<std::string>& cribs) : cribList(cribs) {
+    const uint32_t missing = UINT32_MAX;
+    transitions.assign(256, missing);
+    std::vector<std::vector<uint32_t>> stateOutputs(1);
+
+    for (size_t crib = 0; crib < cribList.size(); crib++) {
+        const std::string& word = cribList[crib];
+        if (word.size() < 2) {
+            throw std::invalid_argument("Cribs must have at least 2 bytes");
+        }
+        uint32_t state = 0;
+        for (size_t i = 0; i + 1 < word.size(); i++) {
+            const unsigned char difference = static_cast<unsigned char>(word[i] ^ word[i + 1]);
+            uint32_t& next = transitions[state * 256 + difference];
+            if (next == missing) {
+                next = static_cast<uint32_t>(stateOutputs.size());
+                stateOutputs.emplace_back();
+                transitions.resize(transitions.size() + 256, missing);
+            }
+            state = transitions[state * 256 + difference];
+        }
+        stateOutputs[state].push_back(static_cast<uint32_t>(crib));
+        const unsigned char first = static_cast<unsigned char>(word[0] ^ word[1]);
+        if (std::find(firstDifferences.begin(), firstDifferences.end(), first) == firstDifferences.end()) {
+            firstDifferences.push_back(first);
+        }
+    }
+
+    std::vector<uint32_t> failure(stateOutputs.size(), 0);
+    std::deque<uint32_t> queue;
+    for (int b = 0; b < 256; b++) {
+        uint32_t& next = transitions[b];
+        if (next == missing) next = 0;
+        else queue.push_back(next);
+    }
+    while (!queue.empty()) {
+        const uint32_t state = queue.front();
+        queue.pop_front();
+        for (int b = 0; b < 256; b++) {
+            const uint32_t fallback = transitions[failure[state] * 256 + b];
+            uint32_t& next = transitions[state * 256 + b];
+            if (next == missing) {
+                next = fallback;
+                continue;
+            }
+            failure[next] = fallback;
+            const auto& inherited = stateOutputs[fallback];
+            stateOutputs[next].insert(stateOutputs[next].end(), inherited.begin(), inherited.end());
+            queue.push_back(next);
+        }
+    }
+
+    outputBegin.reserve(stateOutputs.size() + 1);
+    outputBegin.push_back(0);
+    for (const auto& stateOutput : stateOutputs) {
+        outputs.insert(outputs.end(), stateOutput.begin(), stateOutput.end());
+        outputBegin.push_back(static_cast<uint32_t>(outputs.size()));
+    }
+}
+
+
+//=============================================
+// Search ciphertext for cribs
+// Takes:
+//      ciphertext - single-byte XOR ciphertext (raw bytes)
+//      line       - line index reported in hits
+//      hits       - hits are appended here
+// Note:
+//      O(n): one transition per byte on c[i - 1] ^ c[i]. A crib of length L
+//      ending at byte i starts at i - L + 1 and its key is that byte XOR the
+//      crib's first byte. Root state stays in root on every difference that
+//      doesn't start a crib, so skipping a block without one is exact.
+//=============================================
+
+void CribMatcher::search(std::string_view ciphertext, size_t line, std::vector<CribHit>& hits) const {
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(ciphertext.data());
+    const size_t n = ciphertext.size();
+    const uint32_t* table = transitions.data();
+
+#ifdef CRIB_SEARCH_SSE2
+    const bool skipBlocks = firstDifferences.size() <= maxSkipFirstDifferences;
+    __m128i starts[maxSkipFirstDifferences];
+    for (size_t d = 0; d < firstDifferences.size() && skipBlocks; d++) {
+        starts[d] = _mm_set1_epi8(static_cast<char>(firstDifferences[d]));
+    }
+    // True if differences at positions i .. i + 15 (bytes i - 1 .. i + 15) can't start a crib
+    auto noCribStart = [&](size_t i) {
+        __m128i previous = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes + i - 1));
+        __m128i current = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes + i));
+        __m128i difference = _mm_xor_si128(previous, current);
+        __m128i found = _mm_setzero_si128();
+        for (size_t d = 0; d < firstDifferences.size(); d++) {
+            found = _mm_or_si128(found, _mm_cmpeq_epi8(difference, starts[d]));
+        }
+        return _mm_movemask_epi8(found) == 0;
+    };
+#endif
+
+    uint32_t state = 0;
+    for (size_t i = 1; i < n;) {
+#ifdef CRIB_SEARCH_SSE2
+        if (state == 0 && skipBlocks) {
+            while (i + 16 <= n && noCribStart(i)) i += 16;
+        }
+#endif
+        const size_t blockEnd = std::min(n, i + 16);
+        for (; i < blockEnd; i++) {
+            state = table[state * 256 + (bytes[i - 1] ^ bytes[i])];
+            for (uint32_t o = outputBegin[state]; o < outputBegin[state + 1]; o++) {
+                const std::string& crib = cribList[outputs[o]];
+                const size_t offset = i + 1 - crib.size();
+                hits.push_back({ line, bytes[offset] ^ static_cast<unsigned char>(crib[0]), offset, outputs[o] });
+            }
+        }
+    }
+}
+
+
+//=============================================
+// Default crib matcher
+// Returns:
+//      Matcher of defaultCribs() (thread-safe lazy init)
+//=============================================
+
+const CribMatcher& defaultCribMatcher() {
+    static const CribMatcher matcher(defaultCribs());
+    return matcher;
+}
+
+
+//=============================================
+// Find cribs in ciphertext lines
+// Takes:
+//      lines   - single-byte XOR ciphertext lines (raw bytes)
+//      matcher - compiled cribs
+// Returns:
+//      Hits of all lines, sorted by line, offset and crib
+// Note:
+//      Blocks of lines are searched in parallel on the default thread pool
+//=============================================
+
+std::vector<CribHit> findCribs(const std::vector<std::string>& lines, const CribMatcher& matcher) {
+    const size_t linesPerBlock = 1024;
+    const size_t blocks = (lines.size() + linesPerBlock - 1) / linesPerBlock;
+    std::vector<std::vector<CribHit>> blockHits(blocks);
+    defaultThreadPool().parallelFor(blocks, [&](size_t block) {
+        const size_t end = std::min(lines.size(), (block + 1) * linesPerBlock);
+        for (size_t line = block * linesPerBlock; line < end; line++) {
+            matcher.search(lines[line], line, blockHits[block]);
+        }
+        std::sort(blockHits[block].begin(), blockHits[block].end(), [](const CribHit& a, const CribHit& b) {
+            if (a.line != b.line) return a.line < b.line;
+            if (a.offset != b.offset) return a.offset < b.offset;
+            return a.crib < b.crib;
+            });
+        });
+
+    std::vector<CribHit> hits;
+    for (auto& block : blockHits) {
+        hits.insert(hits.end(), block.begin(), block.end());
+    }
+    return hits;
+}
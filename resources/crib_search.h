@@ -0,0 +1,69 @@
+#ifndef CRIB_SEARCH_H
+#define CRIB_SEARCH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// ==============================
+// CRIB SEARCH - Finds common words in single-byte XOR ciphertext under every key at once
+//
+// XOR with one key byte leaves the XOR of adjacent bytes unchanged:
+// (p[i] ^ k) ^ (p[i + 1] ^ k) == p[i] ^ p[i + 1]. A crib of L bytes is
+// therefore found under any key by matching its L - 1 adjacent differences
+// against the differences of the ciphertext, and the key of a match is
+// c[offset] ^ crib[0]. All cribs share one Aho-Corasick automaton over the
+// difference alphabet, compiled to a dense transition table (a few dozen
+// states for the default cribs, so it stays in L1): the scan is one table
+// lookup per ciphertext byte, with no decryption and no per-key pass.
+// With SSE2, while the automaton is in its root state, 16-byte blocks that
+// hold no first difference of any crib are skipped with a few compares.
+//
+// Meant as a prefilter for line detection (set1/4): lines with hits are
+// likely encrypted English and the hit already names the key.
+// ==============================
+
+// Cribs searched by default: frequent English words and word endings with their spaces
+const std::vector<std::string>& defaultCribs();
+
+// One occurrence of a crib
+struct CribHit {
+    size_t line = 0;        // index of the ciphertext line
+    int key = 0;            // single-byte key that decrypts the crib
+    size_t offset = 0;      // offset of the crib's first byte in the line
+    size_t crib = 0;        // index of the crib
+};
+
+class CribMatcher {
+public:
+    // Compiles the automaton (throws std::invalid_argument for cribs shorter than 2 bytes)
+    explicit CribMatcher(const std::vector<std::string>& cribs = defaultCribs());
+
+    // Appends hits of every crib under every key in ciphertext, reported with given line index
+    void search(std::string_view ciphertext, size_t line, std::vector<CribHit>& hits) const;
+
+    const std::vector<std::string>& cribs() const { return cribList; }
+
+    // Number of automaton states
+    size_t states() const { return outputBegin.size() - 1; }
+
+private:
+    std::vector<std::string> cribList;
+    std::vector<uint32_t> transitions;      // next state at [state * 256 + difference byte]
+    std::vector<uint32_t> outputBegin;      // cribs ending in state s are outputs[outputBegin[s] .. outputBegin[s + 1])
+    std::vector<uint32_t> outputs;
+    std::vector<unsigned char> firstDifferences;   // distinct first difference of every crib
+};
+
+// Block skipping is used up to this many distinct first differences (one compare each per block)
+constexpr size_t maxSkipFirstDifferences = 16;
+
+// Matcher of defaultCribs(), built on first use
+const CribMatcher& defaultCribMatcher();
+
+// Hits in all lines (lines in parallel), sorted by line and offset
+std::vector<CribHit> findCribs(const std::vector<std::string>& lines, const CribMatcher& matcher = defaultCribMatcher());
+
+#endif // CRIB_SEARCH_H
@@ -0,0 +1,327 @@
+#include "instrumentation.h"
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+    constexpr size_t stageSlots = static_cast<size_t>(Stage::Count);
+    constexpr size_t counterSlots = static_cast<size_t>(StageCounter::Count);
+
+    // Spans kept per thread for the Chrome trace, later ones are only counted
+    constexpr size_t maxSpansPerThread = size_t{ 1 } << 20;
+
+    struct Span {
+        Stage stage;
+        int64_t start;          // ns since trace epoch
+        int64_t duration;       // ns
+    };
+
+    // Slots of one thread. Only the owning thread writes them, so counters are
+    // updated with plain relaxed load + store; atomics only make report reads safe.
+    struct ThreadRecord {
+        int index = 0;
+        std::atomic<uint64_t> nanoseconds[stageSlots]{};
+        std::atomic<uint64_t> calls[stageSlots]{};
+        std::atomic<uint64_t> counters[stageSlots][counterSlots]{};
+        std::mutex spansMutex;
+        std::vector<Span> spans;
+        uint64_t droppedSpans = 0;
+    };
+
+    std::atomic<bool> recording{ false };
+    std::atomic<int64_t> epoch{ 0 };
+    std::mutex registryMutex;
+    std::vector<std::unique_ptr<ThreadRecord>> registry;   // records outlive their threads
+
+    int64_t steadyNanoseconds() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    ThreadRecord& threadRecord() {
+        thread_local ThreadRecord* record = nullptr;
+        if (record == nullptr) {
+            std::lock_guard<std::mutex> lock(registryMutex);
+            registry.push_back(std::make_unique<ThreadRecord>());
+            record = registry.back().get();
+            record->index = static_cast<int>(registry.size()) - 1;
+        }
+        return *record;
+    }
+
+    void addToSlot(std::atomic<uint64_t>& slot, uint64_t value) {
+        slot.store(slot.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+    }
+
+    // Plain copy of recorded values (one thread or sum over threads)
+    struct StageTotals {
+        uint64_t calls[stageSlots]{};
+        uint64_t nanoseconds[stageSlots]{};
+        uint64_t counters[stageSlots][counterSlots]{};
+
+        void add(const ThreadRecord& record) {
+            for (size_t s = 0; s < stageSlots; s++) {
+                calls[s] += record.calls[s].load(std::memory_order_relaxed);
+                nanoseconds[s] += record.nanoseconds[s].load(std::memory_order_relaxed);
+                for (size_t c = 0; c < counterSlots; c++) {
+                    counters[s][c] += record.counters[s][c].load(std::memory_order_relaxed);
+                }
+            }
+        }
+
+        bool used(size_t s) const {
+            if (calls[s] != 0) return true;
+            for (size_t c = 0; c < counterSlots; c++) {
+                if (counters[s][c] != 0) return true;
+            }
+            return false;
+        }
+    };
+
+    // Writes {"name": {"calls": .., "ns": .., counters..}, ...} for every used stage
+    void writeStages(std::ostringstream& out, const StageTotals& totals) {
+        out << "{";
+        bool first = true;
+        for (size_t s = 0; s < stageSlots; s++) {
+            if (!totals.used(s)) continue;
+            out << (first ? "" : ",") << "\"" << stageName(static_cast<Stage>(s)) << "\":{\"calls\":" << totals.calls[s] << ",\"ns\":" << totals.nanoseconds[s];
+            for (size_t c = 0; c < counterSlots; c++) {
+                out << ",\"" << stageCounterName(static_cast<StageCounter>(c)) << "\":" << totals.counters[s][c];
+            }
+            out << "}";
+            first = false;
+        }
+        out << "}";
+    }
+
+    void writeFile(const std::string& filename, const std::string& content) {
+        std::ofstream file(filename, std::ios::binary);
+        if (!file.is_open()) {
+            throw std::runtime_error("Error: Could not open file " + filename);
+        }
+        file << content;
+        if (!file) {
+            throw std::runtime_error("Error: Could not write file " + filename);
+        }
+    }
+}
+
+
+//=============================================
+// Stage and counter names
+//=============================================
+
+const char* stageName(Stage stage) {
+    switch (stage) {
+    case Stage::Base64Decode: return "base64_decode";
+    case Stage::Base64Encode: return "base64_encode";
+    case Stage::HexDecode: return "hex_decode";
+    case Stage::HexEncode: return "hex_encode";
+    case Stage::BinaryConversion: return "binary_conversion";
+    case Stage::KeysizeDetection: return "keysize_detection";
+    case Stage::Transposition: return "transposition";
+    case Stage::ColumnScoring: return "column_scoring";
+    case Stage::KeyRefinement: return "key_refinement";
+    case Stage::KeySelection: return "key_selection";
+    case Stage::Decrypt: return "decrypt";
+    default: return "unknown";
+    }
+}
+
+const char* stageCounterName(StageCounter counter) {
+    switch (counter) {
+    case StageCounter::Bytes: return "bytes";
+    case StageCounter::KeysScored: return "keys_scored";
+    case StageCounter::CandidatesPruned: return "candidates_pruned";
+    default: return "unknown";
+    }
+}
+
+
+//=============================================
+// Enable / disable recording
+// Takes:
+//      enabled - record timers and counters from now on
+// Note:
+//      First enabling sets the trace epoch (timestamp 0 of Chrome trace)
+//=============================================
+
+void setInstrumentationEnabled(bool enabled) {
+    int64_t unset = 0;
+    if (enabled) epoch.compare_exchange_strong(unset, steadyNanoseconds());
+    recording.store(enabled, std::memory_order_relaxed);
+}
+
+bool instrumentationEnabled() {
+    return recording.load(std::memory_order_relaxed);
+}
+
+
+//=============================================
+// Reset all recorded data
+// Note:
+//      Meant to be called between runs, counts added by threads
+//      still recording at the same time may survive the reset
+//=============================================
+
+void resetInstrumentation() {
+    std::lock_guard<std::mutex> lock(registryMutex);
+    for (auto& record : registry) {
+        for (size_t s = 0; s < stageSlots; s++) {
+            record->nanoseconds[s].store(0, std::memory_order_relaxed);
+            record->calls[s].store(0, std::memory_order_relaxed);
+            for (size_t c = 0; c < counterSlots; c++) {
+                record->counters[s][c].store(0, std::memory_order_relaxed);
+            }
+        }
+        std::lock_guard<std::mutex> spansLock(record->spansMutex);
+        record->spans.clear();
+        record->droppedSpans = 0;
+    }
+    epoch.store(steadyNanoseconds());
+}
+
+
+//=============================================
+// Add to a stage counter
+// Takes:
+//      stage   - stage the work belongs to
+//      counter - counter to increase
+//      value   - amount to add
+//=============================================
+
+void countStage(Stage stage, StageCounter counter, uint64_t value) {
+    if (!recording.load(std::memory_order_relaxed)) return;
+    addToSlot(threadRecord().counters[static_cast<size_t>(stage)][static_cast<size_t>(counter)], value);
+}
+
+
+//=============================================
+// Stage timer
+// Note:
+//      Whether the span is recorded is decided at construction, so a stage
+//      that started before recording was enabled is never half-counted
+//=============================================
+
+StageTimer::StageTimer(Stage stage) : stage(stage) {
+    if (recording.load(std::memory_order_relaxed)) start = steadyNanoseconds() - epoch.load(std::memory_order_relaxed);
+}
+
+StageTimer::~StageTimer() {
+    if (start < 0) return;
+    const int64_t duration = steadyNanoseconds() - epoch.load(std::memory_order_relaxed) - start;
+    ThreadRecord& record = threadRecord();
+    addToSlot(record.nanoseconds[static_cast<size_t>(stage)], static_cast<uint64_t>(duration));
+    addToSlot(record.calls[static_cast<size_t>(stage)], 1);
+
+    std::lock_guard<std::mutex> lock(record.spansMutex);
+    if (record.spans.size() < maxSpansPerThread) record.spans.push_back({ stage, start, duration });
+    else record.droppedSpans++;
+}
+
+
+//=============================================
+// Stage totals over all threads
+//=============================================
+
+uint64_t stageNanoseconds(Stage stage) {
+    std::lock_guard<std::mutex> lock(registryMutex);
+    uint64_t total = 0;
+    for (const auto& record : registry) total += record->nanoseconds[static_cast<size_t>(stage)].load(std::memory_order_relaxed);
+    return total;
+}
+
+uint64_t stageCalls(Stage stage) {
+    std::lock_guard<std::mutex> lock(registryMutex);
+    uint64_t total = 0;
+    for (const auto& record : registry) total += record->calls[static_cast<size_t>(stage)].load(std::memory_order_relaxed);
+    return total;
+}
+
+uint64_t stageCount(Stage stage, StageCounter counter) {
+    std::lock_guard<std::mutex> lock(registryMutex);
+    uint64_t total = 0;
+    for (const auto& record : registry) total += record->counters[static_cast<size_t>(stage)][static_cast<size_t>(counter)].load(std::memory_order_relaxed);
+    return total;
+}
+
+
+//=============================================
+// JSON report
+// Returns:
+//      {"stages": {name: {calls, ns, counters}}, "threads": [{"thread", "dropped_spans", "stages"}]}
+// Note:
+//      Stages with no calls and no counts are left out
+//=============================================
+
+std::string instrumentationJson() {
+    std::lock_guard<std::mutex> lock(registryMutex);
+    StageTotals totals;
+    for (const auto& record : registry) totals.add(*record);
+
+    std::ostringstream out;
+    out << "{\"stages\":";
+    writeStages(out, totals);
+    out << ",\"threads\":[";
+    for (size_t t = 0; t < registry.size(); t++) {
+        StageTotals threadTotals;
+        threadTotals.add(*registry[t]);
+        uint64_t droppedSpans;
+        {
+            std::lock_guard<std::mutex> spansLock(registry[t]->spansMutex);
+            droppedSpans = registry[t]->droppedSpans;
+        }
+        out << (t ? "," : "") << "{\"thread\":" << registry[t]->index << ",\"dropped_spans\":" << droppedSpans << ",\"stages\":";
+        writeStages(out, threadTotals);
+        out << "}";
+    }
+    out << "]}";
+    return out.str();
+}
+
+
+//=============================================
+// Chrome trace-event report
+// Returns:
+//      {"traceEvents": [...]} with one complete ("X") event per recorded span
+//=============================================
+
+std::string instrumentationChromeTrace() {
+    std::lock_guard<std::mutex> lock(registryMutex);
+    std::ostringstream out;
+    out.setf(std::ios::fixed);
+    out.precision(3);
+    out << "{\"traceEvents\":[";
+    bool first = true;
+    for (const auto& record : registry) {
+        std::lock_guard<std::mutex> spansLock(record->spansMutex);
+        for (const Span& span : record->spans) {
+            out << (first ? "" : ",\n") << "{\"name\":\"" << stageName(span.stage) << "\",\"cat\":\"xor\",\"ph\":\"X\",\"pid\":1,\"tid\":" << record->index
+                << ",\"ts\":" << span.start / 1000.0 << ",\"dur\":" << span.duration / 1000.0 << "}";
+            first = false;
+        }
+    }
+    out << "],\"displayTimeUnit\":\"ns\"}";
+    return out.str();
+}
+
+
+//=============================================
+// Write reports to files
+// Takes:
+//      filename - output file
+// Throws:
+//      std::runtime_error if the file can't be opened or written
+//=============================================
+
+void writeInstrumentationJson(const std::string& filename) {
+    writeFile(filename, instrumentationJson());
+}
+
+void writeChromeTrace(const std::string& filename) {
+    writeFile(filename, instrumentationChromeTrace());
+}
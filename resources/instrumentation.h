@@ -0,0 +1,100 @@
+#ifndef INSTRUMENTATION_H
+#define INSTRUMENTATION_H
+
+#include <cstdint>
+#include <string>
+
+// ==============================
+// INSTRUMENTATION - Per-stage timers and counters of the breaking pipeline
+//
+// Stages mark their work with a scoped StageTimer and add to counters.
+// Every thread records into its own slots, which are only read when a
+// report is made, so recording threads never contend with each other.
+// Reports aggregate per stage and per thread (JSON) or list every timed
+// span (Chrome trace-event format, open in chrome://tracing or Perfetto).
+//
+// Recording is off by default: a disabled timer or counter costs one relaxed
+// atomic load. Defining XOR_DISABLE_INSTRUMENTATION at compile time removes
+// the XOR_STAGE_TIMER / XOR_STAGE_COUNT call sites completely.
+//
+// Stage times are inclusive, a stage running inside another one (e.g.
+// column scoring inside a parallel keysize loop) is counted in both.
+// ==============================
+
+enum class Stage {
+    Base64Decode,
+    Base64Encode,
+    HexDecode,
+    HexEncode,
+    BinaryConversion,   // bit strings to bytes and back
+    KeysizeDetection,
+    Transposition,      // column histograms of candidate keysizes
+    ColumnScoring,      // single-byte key search of one column
+    KeyRefinement,      // beam search and hill climbing
+    KeySelection,       // ranking of candidate keys
+    Decrypt,
+    Count
+};
+
+enum class StageCounter {
+    Bytes,              // input bytes processed
+    KeysScored,         // candidate keys scored
+    CandidatesPruned,   // candidate keys rejected before or without scoring
+    Count
+};
+
+// Short stage and counter names used in reports
+const char* stageName(Stage stage);
+const char* stageCounterName(StageCounter counter);
+
+// Turns recording on or off for all threads (already recorded data is kept)
+void setInstrumentationEnabled(bool enabled);
+bool instrumentationEnabled();
+
+// Clears everything recorded so far, trace timestamps restart from 0
+void resetInstrumentation();
+
+// Adds value to a counter of stage (no-op while disabled)
+void countStage(Stage stage, StageCounter counter, uint64_t value);
+
+// Total time (ns) and calls of stage summed over all threads
+uint64_t stageNanoseconds(Stage stage);
+uint64_t stageCalls(Stage stage);
+uint64_t stageCount(Stage stage, StageCounter counter);
+
+// Per stage totals and per thread breakdown as a JSON object
+std::string instrumentationJson();
+
+// Every recorded span as Chrome trace-event JSON ("X" complete events, timestamps in microseconds)
+std::string instrumentationChromeTrace();
+
+// Write reports to files (throw std::runtime_error if the file can't be written)
+void writeInstrumentationJson(const std::string& filename);
+void writeChromeTrace(const std::string& filename);
+
+// Times a stage from construction to destruction (records only if enabled at construction)
+class StageTimer {
+public:
+    explicit StageTimer(Stage stage);
+    ~StageTimer();
+
+    StageTimer(const StageTimer&) = delete;
+    StageTimer& operator=(const StageTimer&) = delete;
+
+private:
+    Stage stage;
+    int64_t start = -1;     // ns since trace epoch, -1 if not recording
+};
+
+#define XOR_INSTRUMENTATION_CONCAT_(a, b) a##b
+#define XOR_INSTRUMENTATION_CONCAT(a, b) XOR_INSTRUMENTATION_CONCAT_(a, b)
+
+#ifdef XOR_DISABLE_INSTRUMENTATION
+#define XOR_STAGE_TIMER(stage) ((void)0)
+#define XOR_STAGE_COUNT(stage, counter, value) ((void)0)
+#else
+#define XOR_STAGE_TIMER(stage) StageTimer XOR_INSTRUMENTATION_CONCAT(stageTimer_, __LINE__)(stage)
+#define XOR_STAGE_COUNT(stage, counter, value) countStage(stage, counter, value)
+#endif
+
+#endif // INSTRUMENTATION_H
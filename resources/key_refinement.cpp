@@ -0,0 +1,385 @@
+#include "key_refinement.h"
+#include "allocation_tracker.h"
+#include "instrumentation.h"
+#include "pair_scoring.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+//=============================================
+// Log-likelihood of a decoded column
+// Takes:
+//      hist  - byte histogram of encrypted column
+//      key   - key byte to decode the column with
+//      model - byte language model
+// Returns:
+//      Sum of unigram log-probabilities of all decoded bytes
+//=============================================
+
+double columnKeyLogLikelihood(const ByteHistogram& hist, int key, const ByteLanguageModel& model) {
+    double score = 0;
+    for (int b = 0; b < 256; b++) {
+        if (hist[b] != 0) score += hist[b] * static_cast<double>(model.unigram[b ^ key]);
+    }
+    return score;
+}
+
+
+//=============================================
+// Top key candidates of a column
+// Takes:
+//      hist  - byte histogram of encrypted column
+//      model - byte language model
+//      count - number of candidates to return
+// Returns:
+//      Key bytes sorted by log-likelihood of decoded column (best first)
+//=============================================
+
+std::vector<int> topColumnKeys(const ByteHistogram& hist, const ByteLanguageModel& model, int count) {
+    // Short columns hold few distinct bytes, only those are scored for every key
+    double scores[256] = {};
+    unigramKeyScores(hist, model.unigram, scores);
+
+    // Insertion into the sorted top list, most keys lose to its last entry with one comparison.
+    // Equal scores keep the lower key first.
+    count = std::clamp(count, 0, 256);
+    int top[256];
+    int size = 0;
+    for (int key = 0; key < 256 && count > 0; key++) {
+        if (size == count && !(scores[key] > scores[top[size - 1]])) continue;
+        int position = size < count ? size++ : size - 1;
+        for (; position > 0 && scores[key] > scores[top[position - 1]]; position--) {
+            top[position] = top[position - 1];
+        }
+        top[position] = key;
+    }
+    return std::vector<int>(top, top + size);
+}
+
+
+//=============================================
+// Posterior of a column key byte
+// Takes:
+//      hist  - byte histogram of encrypted column
+//      key   - key byte to rate
+//      model - byte language model
+// Returns:
+//      Probability (0-1) that key is the right byte among all 256,
+//      with log-likelihood of decoded column as log-weight of each byte
+//=============================================
+
+double columnKeyPosterior(const ByteHistogram& hist, int key, const ByteLanguageModel& model) {
+    std::vector<double> logLikelihood(256, 0.0);
+    unigramKeyScores(hist, model.unigram, logLikelihood.data());     // columnKeyLogLikelihood of every key
+    const double reference = logLikelihood[key & 0xFF];
+    double normalizer = 0;
+    for (double ll : logLikelihood) {
+        normalizer += std::exp(std::min(ll - reference, 700.0));   // clamp keeps exp finite, result is ~0 anyway
+    }
+    return 1.0 / normalizer;
+}
+
+
+//=============================================
+// Posterior of a whole key
+// Takes:
+//      columnHistograms - byte histograms of all key columns
+//      key              - key to rate, one byte per column
+//      model            - byte language model
+// Returns:
+//      Product of column posteriors (0 if key length doesn't match)
+//=============================================
+
+double keyPosterior(const std::vector<ByteHistogram>& columnHistograms, std::string_view key, const ByteLanguageModel& model) {
+    if (key.empty() || key.size() != columnHistograms.size()) return 0.0;
+    double posterior = 1.0;
+    for (size_t c = 0; c < key.size(); c++) {
+        posterior *= columnKeyPosterior(columnHistograms[c], static_cast<unsigned char>(key[c]), model);
+    }
+    return posterior;
+}
+
+
+//=============================================
+// Bigram score across a column boundary
+// Takes:
+//      data    - ciphertext
+//      keysize - tested keysize
+//      column  - column of the first byte of each pair
+//      keyA    - key byte of column
+//      keyB    - key byte of column + 1 (column 0 when column is the last one)
+//      model   - byte language model
+// Returns:
+//      Sum of log P(plain[p], plain[p + 1]) over p in column, O(n / keysize)
+// Note:
+//      Scores one key pair, beam search ranks all candidate pairs of a
+//      boundary on pair indices built once (see pair_scoring.h)
+//=============================================
+
+double boundaryPairScore(std::string_view data, int keysize, int column, int keyA, int keyB, const ByteLanguageModel& model) {
+    auto pairs = boundaryPairIndices(data, keysize, column);
+    return pairTableScore(pairs.data(), pairs.size(), model.bigram, static_cast<unsigned>((keyA & 0xFF) << 8 | (keyB & 0xFF)));
+}
+
+
+//=============================================
+// Beam search key refinement
+// Takes:
+//      data                - ciphertext
+//      keysize             - tested keysize
+//      candidatesPerColumn - key bytes kept per column
+//      beamWidth           - partial keys kept after each column
+// Returns:
+//      Key with best bigram log-likelihood among explored combinations
+// Note:
+//      Score of a partial key is the sum of boundary scores between its
+//      columns. Adding column i only adds boundary (i - 1, i), whose scores
+//      for all candidate pairs are computed once. The wrap-around boundary
+//      (last column, column 0) is added when the key is complete.
+//=============================================
+
+std::string refineKeyBeamSearch(std::string_view data, int keysize, int candidatesPerColumn, int beamWidth) {
+    if (keysize <= 0 || candidatesPerColumn <= 0 || beamWidth <= 0) {
+        throw std::invalid_argument("Keysize, candidate count and beam width must be positive");
+    }
+    XOR_STAGE_TIMER(Stage::KeyRefinement);
+    XOR_ALLOCATION_SCOPE(Stage::KeyRefinement);
+    XOR_STAGE_COUNT(Stage::KeyRefinement, StageCounter::Bytes, data.size());
+    const ByteLanguageModel& model = defaultLanguageModel();
+    auto columnHistograms = buildColumnHistograms(data, keysize);
+
+    std::vector<std::vector<int>> candidates(keysize);
+    for (int c = 0; c < keysize; c++) {
+        candidates[c] = topColumnKeys(columnHistograms[c], model, candidatesPerColumn);
+    }
+
+    // Scores of every candidate pair across boundary (column, column + 1)
+    auto boundaryScores = [&](int column) {
+        int next = (column + 1) % keysize;
+        auto pairs = boundaryPairIndices(data, keysize, column);
+        std::vector<double> scores(candidates[column].size() * candidates[next].size());
+        for (size_t a = 0; a < candidates[column].size(); a++) {
+            for (size_t b = 0; b < candidates[next].size(); b++) {
+                unsigned keyPair = static_cast<unsigned>(candidates[column][a] << 8 | candidates[next][b]);
+                scores[a * candidates[next].size() + b] = pairTableScore(pairs.data(), pairs.size(), model.bigram, keyPair);
+            }
+        }
+        return scores;
+    };
+
+    struct BeamState {
+        std::vector<int> choice;    // candidate index for each column so far
+        double score;
+    };
+
+    auto keepBest = [beamWidth](std::vector<BeamState>& states) {
+        XOR_STAGE_COUNT(Stage::KeyRefinement, StageCounter::KeysScored, states.size());
+        if (states.size() <= static_cast<size_t>(beamWidth)) return;
+        XOR_STAGE_COUNT(Stage::KeyRefinement, StageCounter::CandidatesPruned, states.size() - beamWidth);
+        std::partial_sort(states.begin(), states.begin() + beamWidth, states.end(), [](const BeamState& a, const BeamState& b) {
+            return a.score > b.score;
+            });
+        states.resize(beamWidth);
+    };
+
+    std::vector<BeamState> beam;
+    for (size_t a = 0; a < candidates[0].size(); a++) {
+        beam.push_back({ { static_cast<int>(a) }, 0.0 });
+    }
+    keepBest(beam);
+
+    for (int column = 1; column < keysize; column++) {
+        auto scores = boundaryScores(column - 1);
+        const size_t width = candidates[column].size();
+        std::vector<BeamState> extended;
+        extended.reserve(beam.size() * width);
+        for (const auto& state : beam) {
+            for (size_t b = 0; b < width; b++) {
+                BeamState next = state;
+                next.choice.push_back(static_cast<int>(b));
+                next.score += scores[state.choice[column - 1] * width + b];
+                extended.push_back(std::move(next));
+            }
+        }
+        keepBest(extended);
+        beam = std::move(extended);
+    }
+
+    // Close the cycle: last column is followed by column 0 of the next block
+    auto wrapScores = boundaryScores(keysize - 1);
+    const size_t firstWidth = candidates[0].size();
+    for (auto& state : beam) {
+        state.score += wrapScores[state.choice[keysize - 1] * firstWidth + state.choice[0]];
+    }
+
+    const auto& best = *std::max_element(beam.begin(), beam.end(), [](const BeamState& a, const BeamState& b) {
+        return a.score < b.score;
+        });
+
+    std::string key(keysize, '\0');
+    for (int c = 0; c < keysize; c++) {
+        key[c] = static_cast<char>(candidates[c][best.choice[c]]);
+    }
+    return key;
+}
+
+
+//=============================================
+// Quadgram fitness of decrypted data
+// Takes:
+//      data - ciphertext
+//      key  - repeating key
+// Returns:
+//      Sum of log P(quadgram) over every window of four plaintext bytes,
+//      plus byte unigram log P of every plaintext byte
+// Note:
+//      Quadgram classes ignore case, the unigram term (with its uppercase
+//      penalty) tells a key byte from the same byte with flipped case bit
+//=============================================
+
+double quadgramFitness(std::string_view data, std::string_view key) {
+    if (key.empty()) {
+        throw std::invalid_argument("Key must not be empty");
+    }
+    const QuadgramModel& model = defaultQuadgramModel();
+    const ByteLanguageModel& byteModel = defaultLanguageModel();
+    std::vector<unsigned char> classes(data.size());
+    double fitness = 0;
+    for (size_t i = 0; i < data.size(); i++) {
+        unsigned char plain = static_cast<unsigned char>(data[i] ^ key[i % key.size()]);
+        classes[i] = model.byteClass[plain];
+        fitness += byteModel.unigram[plain];
+    }
+    for (size_t s = 0; s + 3 < classes.size(); s++) {
+        fitness += model.logProb[QuadgramModel::quadgramIndex(classes[s], classes[s + 1], classes[s + 2], classes[s + 3])];
+    }
+    return fitness;
+}
+
+
+//=============================================
+// Hill-climbing key refinement
+// Takes:
+//      data                - ciphertext
+//      key                 - starting key (its length is the keysize)
+//      candidatesPerColumn - key bytes tried per column (top by unigram likelihood)
+//      maxIterations       - maximal number of evaluated mutations
+// Returns:
+//      Refined key (never worse than the starting key)
+// Note:
+//      Plaintext is kept as a buffer of byte classes. Changing key byte j
+//      changes the classes of column j only, so the fitness delta is summed
+//      over windows starting at q - 3 .. q for every q in column j. With
+//      keysize >= 4 a window holds at most one byte of the column, shorter
+//      keys mutate the column in place and rescore all windows against the
+//      cached sum for the current key.
+//      Unigram part of the delta comes from the column histogram in O(256).
+//=============================================
+
+std::string refineKeyHillClimb(std::string_view data, const std::string& key, int candidatesPerColumn, int maxIterations) {
+    if (key.empty()) {
+        throw std::invalid_argument("Key must not be empty");
+    }
+    XOR_STAGE_TIMER(Stage::KeyRefinement);
+    XOR_ALLOCATION_SCOPE(Stage::KeyRefinement);
+    XOR_STAGE_COUNT(Stage::KeyRefinement, StageCounter::Bytes, data.size());
+    const QuadgramModel& model = defaultQuadgramModel();
+    const int keysize = static_cast<int>(key.size());
+    const size_t n = data.size();
+    if (n < 4) return key;
+
+    std::string bestKey = key;
+    std::vector<unsigned char> classes(n);
+    for (size_t i = 0; i < n; i++) {
+        classes[i] = model.byteClass[static_cast<unsigned char>(data[i] ^ bestKey[i % keysize])];
+    }
+    auto window = [&](const unsigned char* c) {
+        return model.logProb[QuadgramModel::quadgramIndex(c[0], c[1], c[2], c[3])];
+    };
+
+    // Sum over all windows, kept for the current key when keysize < 4
+    auto windowsFitness = [&]() {
+        double fitness = 0;
+        for (size_t s = 0; s + 3 < n; s++) fitness += window(&classes[s]);
+        return fitness;
+    };
+    double currentWindowsFitness = keysize < 4 ? windowsFitness() : 0;
+
+    auto columnHistograms = buildColumnHistograms(data, keysize);
+    const ByteLanguageModel& byteModel = defaultLanguageModel();
+
+    // Fitness change if column j is decrypted with newKey instead of its current byte
+    auto mutationDelta = [&](int j, unsigned char newKey) {
+        // Unigram part straight from column histogram
+        const unsigned char oldKey = static_cast<unsigned char>(bestKey[j]);
+        double delta = 0;
+        for (int b = 0; b < 256; b++) {
+            if (columnHistograms[j][b] != 0)
+                delta += columnHistograms[j][b] * static_cast<double>(byteModel.unigram[b ^ newKey] - byteModel.unigram[b ^ oldKey]);
+        }
+        if (keysize < 4) {
+            // Every window holds a byte of column j: rescore all of them with the
+            // column mutated in place, then put the current classes back
+            for (size_t q = j; q < n; q += keysize) {
+                classes[q] = model.byteClass[static_cast<unsigned char>(data[q] ^ newKey)];
+            }
+            delta += windowsFitness() - currentWindowsFitness;
+            for (size_t q = j; q < n; q += keysize) {
+                classes[q] = model.byteClass[static_cast<unsigned char>(data[q] ^ oldKey)];
+            }
+            return delta;
+        }
+        for (size_t q = j; q < n; q += keysize) {
+            // Bytes q - 3 .. q + 3 around the changed byte, out of range bytes are never read
+            unsigned char local[7];
+            size_t first = q >= 3 ? q - 3 : 0;
+            size_t last = std::min(q + 3, n - 1);
+            for (size_t p = first; p <= last; p++) local[p - q + 3] = classes[p];
+            const unsigned char oldClass = local[3];
+            for (size_t s = first; s <= q && s + 3 <= last; s++) {
+                delta -= window(&local[s - q + 3]);
+            }
+            local[3] = model.byteClass[static_cast<unsigned char>(data[q] ^ newKey)];
+            for (size_t s = first; s <= q && s + 3 <= last; s++) {
+                delta += window(&local[s - q + 3]);
+            }
+            local[3] = oldClass;
+        }
+        return delta;
+    };
+
+    std::vector<std::vector<int>> candidates(keysize);
+    for (int j = 0; j < keysize; j++) {
+        candidates[j] = topColumnKeys(columnHistograms[j], byteModel, candidatesPerColumn);
+    }
+
+    int iterations = 0;
+    bool improved = true;
+    while (improved && iterations < maxIterations) {
+        improved = false;
+        for (int j = 0; j < keysize && iterations < maxIterations; j++) {
+            double bestDelta = 0;
+            int bestByte = -1;
+            for (int candidate : candidates[j]) {
+                if (iterations >= maxIterations) break;
+                if (candidate == static_cast<unsigned char>(bestKey[j])) continue;
+                iterations++;
+                double delta = mutationDelta(j, static_cast<unsigned char>(candidate));
+                if (delta > bestDelta) {
+                    bestDelta = delta;
+                    bestByte = candidate;
+                }
+            }
+            if (bestByte >= 0) {
+                bestKey[j] = static_cast<char>(bestByte);
+                for (size_t q = j; q < n; q += keysize) {
+                    classes[q] = model.byteClass[static_cast<unsigned char>(data[q] ^ bestByte)];
+                }
+                if (keysize < 4) currentWindowsFitness = windowsFitness();
+                improved = true;
+            }
+        }
+    }
+    XOR_STAGE_COUNT(Stage::KeyRefinement, StageCounter::KeysScored, iterations);
+    return bestKey;
+}
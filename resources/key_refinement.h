@@ -0,0 +1,69 @@
+#ifndef KEY_REFINEMENT_H
+#define KEY_REFINEMENT_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include "column_stats.h"
+#include "language_model.h"
+
+// ==============================
+// KEY REFINEMENT - Search over key candidates beyond per-column best fit
+//
+// Per-column frequency analysis picks every key byte on its own and fails on
+// short columns. Refiners here score whole plaintext candidates with byte
+// language model statistics that cross column boundaries.
+// ==============================
+
+// Refiners score whole plaintext, inputs are cut to this many bytes before refining
+// (plenty to compare keys, and keeps refinement cost independent of the input size)
+constexpr size_t maxRefinementBytes = size_t{ 1 } << 20;
+
+// Candidate key bytes kept per column and partial keys kept per step of beam search
+constexpr int defaultBeamCandidates = 5;
+constexpr int defaultBeamWidth = 32;
+
+// Columns shorter than this are solved by beam search, single-column Chi^2 picks wrong bytes too often
+constexpr size_t minFrequencyAnalysisColumnLength = 64;
+
+// Columns whose best byte fails chi2threshold are decided by unigram log-likelihood among this many lowest-Chi^2 bytes
+constexpr int chi2FallbackCandidates = 4;
+
+// Unigram log-likelihood of a column decoded with key byte, sum of hist[b] * log P(b ^ key)
+double columnKeyLogLikelihood(const ByteHistogram& hist, int key, const ByteLanguageModel& model);
+
+// Top [count] key bytes of a column, ranked by unigram log-likelihood of the decoded column
+std::vector<int> topColumnKeys(const ByteHistogram& hist, const ByteLanguageModel& model, int count);
+
+// Posterior probability of key byte for a column under the unigram model,
+// exp(LL(key)) / sum over all bytes k of exp(LL(k)). Grows towards 1 as the column gets longer.
+double columnKeyPosterior(const ByteHistogram& hist, int key, const ByteLanguageModel& model);
+
+// Product of column posteriors: probability that every byte of key is right (under the unigram model)
+double keyPosterior(const std::vector<ByteHistogram>& columnHistograms, std::string_view key, const ByteLanguageModel& model);
+
+// Bigram log-likelihood of all adjacent plaintext pairs (p, p + 1) where p is in given column,
+// with keyA decrypting the column and keyB decrypting the next one
+double boundaryPairScore(std::string_view data, int keysize, int column, int keyA, int keyB, const ByteLanguageModel& model);
+
+// Beam search over top candidates of every column, scored by bigram statistics across column boundaries
+// Columns are added one at a time, extending a partial key rescores only the boundary it adds
+std::string refineKeyBeamSearch(std::string_view data, int keysize, int candidatesPerColumn, int beamWidth);
+
+// Candidate key bytes tried per column in each hill-climbing pass, and evaluated mutations limit
+constexpr int defaultHillClimbCandidates = 16;
+constexpr int defaultHillClimbIterations = 20000;
+
+// Keys with keyConfidence below this are refined by hill climbing
+constexpr double lowKeyConfidence = 0.1;
+
+// Quadgram (plus byte unigram) log-likelihood of the plaintext data decrypts to with key
+double quadgramFitness(std::string_view data, std::string_view key);
+
+// Hill climbing from a starting key: mutate one key byte at a time and keep
+// mutations that improve quadgram fitness. A mutation rescores only the quadgrams
+// touching its column, O(n / keysize). Stops when a full pass over all columns
+// brings no improvement or after maxIterations evaluated mutations.
+std::string refineKeyHillClimb(std::string_view data, const std::string& key, int candidatesPerColumn, int maxIterations);
+
+#endif // KEY_REFINEMENT_H
@@ -0,0 +1,252 @@
+#include "keysize_kernels.h"
+#include "perf_counters.h"
+#include <array>
+#include <stdexcept>
+#include <utility>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define KEYSIZE_KERNELS_SSE2 1
+#endif
+
+namespace {
+
+    //=============================================
+    // Specialized kernels, K == keysize
+    // Inner loops over one block have constant trip count K
+    //=============================================
+
+    template <int K>
+    void repeatingKeyXorFixed(const unsigned char* in, unsigned char* out, size_t len, const unsigned char* key) {
+        unsigned char k[K];   // local copy, kept in registers for small K
+        for (int j = 0; j < K; j++) k[j] = key[j];
+
+        size_t i = 0;
+        for (; i + K <= len; i += K) {
+            for (int j = 0; j < K; j++) {
+                out[i + j] = in[i + j] ^ k[j];
+            }
+        }
+        for (int j = 0; i < len; i++, j++) {
+            out[i] = in[i] ^ k[j];
+        }
+    }
+
+    template <int K>
+    void columnHistogramFixed(const unsigned char* data, size_t len, ByteHistogram* columns, size_t startColumn) {
+        size_t i = 0;
+        // Finish the block data starts in, so the main loop is aligned to column 0
+        for (size_t column = startColumn % K; column != 0 && i < len; i++) {
+            columns[column][data[i]]++;
+            if (++column == K) column = 0;
+        }
+        for (; i + K <= len; i += K) {
+            for (int j = 0; j < K; j++) {
+                columns[j][data[i + j]]++;
+            }
+        }
+        for (int j = 0; i < len; i++, j++) {
+            columns[j][data[i]]++;
+        }
+    }
+
+    template <int K>
+    void transposeFixed(const unsigned char* data, size_t len, unsigned char* const* columns) {
+        unsigned char* out[K];
+        for (int j = 0; j < K; j++) out[j] = columns[j];
+
+        size_t row = 0;
+        size_t i = 0;
+        for (; i + K <= len; i += K, row++) {
+            for (int j = 0; j < K; j++) {
+                out[j][row] = data[i + j];
+            }
+        }
+        for (int j = 0; i < len; i++, j++) {
+            out[j][row] = data[i];
+        }
+    }
+
+    //=============================================
+    // Generic kernels for keysizes above maxFixedKeysize
+    //=============================================
+
+    void repeatingKeyXorGeneric(const unsigned char* in, unsigned char* out, size_t len, const unsigned char* key, int keysize) {
+        size_t j = 0;
+        for (size_t i = 0; i < len; i++) {
+            out[i] = in[i] ^ key[j];
+            if (++j == static_cast<size_t>(keysize)) j = 0;
+        }
+    }
+
+    void columnHistogramGeneric(const unsigned char* data, size_t len, ByteHistogram* columns, int keysize, size_t startColumn) {
+        size_t column = startColumn % keysize;
+        for (size_t i = 0; i < len; i++) {
+            columns[column][data[i]]++;
+            if (++column == static_cast<size_t>(keysize)) column = 0;
+        }
+    }
+
+    void transposeGeneric(const unsigned char* data, size_t len, unsigned char* const* columns, int keysize) {
+        size_t column = 0;
+        size_t row = 0;
+        for (size_t i = 0; i < len; i++) {
+            columns[column][row] = data[i];
+            if (++column == static_cast<size_t>(keysize)) {
+                column = 0;
+                row++;
+            }
+        }
+    }
+
+    //=============================================
+    // Jump tables, entry [K - 1] is the kernel specialized for keysize K
+    //=============================================
+
+    using XorKernel = void (*)(const unsigned char*, unsigned char*, size_t, const unsigned char*);
+    using HistogramKernel = void (*)(const unsigned char*, size_t, ByteHistogram*, size_t);
+    using TransposeKernel = void (*)(const unsigned char*, size_t, unsigned char* const*);
+
+    template <size_t... I>
+    constexpr std::array<XorKernel, sizeof...(I)> makeXorKernels(std::index_sequence<I...>) {
+        return { &repeatingKeyXorFixed<static_cast<int>(I) + 1>... };
+    }
+
+    template <size_t... I>
+    constexpr std::array<HistogramKernel, sizeof...(I)> makeHistogramKernels(std::index_sequence<I...>) {
+        return { &columnHistogramFixed<static_cast<int>(I) + 1>... };
+    }
+
+    template <size_t... I>
+    constexpr std::array<TransposeKernel, sizeof...(I)> makeTransposeKernels(std::index_sequence<I...>) {
+        return { &transposeFixed<static_cast<int>(I) + 1>... };
+    }
+
+    constexpr auto xorKernels = makeXorKernels(std::make_index_sequence<maxFixedKeysize>{});
+    constexpr auto histogramKernels = makeHistogramKernels(std::make_index_sequence<maxFixedKeysize>{});
+    constexpr auto transposeKernels = makeTransposeKernels(std::make_index_sequence<maxFixedKeysize>{});
+
+#ifdef KEYSIZE_KERNELS_SSE2
+    //=============================================
+    // SSE2 transposition for keysizes minSse2TransposeKeysize..maxFixedKeysize
+    // Takes blocks of 16 rows, each row is one key-length block of data.
+    // Every 16 columns wide tile of the block is loaded as 16 registers
+    // (one per row) and transposed in registers with byte unpacks, so
+    // register j then holds 16 consecutive bytes of column 16 * tile + j.
+    //=============================================
+
+    // 16x16 byte transpose: four rounds of interleaving row i with row i + 8
+    inline void transpose16x16(__m128i rows[16]) {
+        __m128i tmp[16];
+        for (int round = 0; round < 4; round++) {
+            for (int i = 0; i < 8; i++) {
+                tmp[2 * i] = _mm_unpacklo_epi8(rows[i], rows[i + 8]);
+                tmp[2 * i + 1] = _mm_unpackhi_epi8(rows[i], rows[i + 8]);
+            }
+            for (int i = 0; i < 16; i++) rows[i] = tmp[i];
+        }
+    }
+
+    // Below this keysize most of each 16x16 tile is thrown away and the
+    // unrolled scalar kernel is faster
+    constexpr int minSse2TransposeKeysize = 4;
+
+    void transposeSse2(const unsigned char* data, size_t len, unsigned char* const* columns, int keysize) {
+        const size_t K = static_cast<size_t>(keysize);
+        const size_t tiles = (K + 15) / 16;
+        const size_t fullRows = len / K;
+
+        size_t row = 0;
+        // Last row of the block loads up to 16 * tiles bytes from its start, which must stay inside data
+        for (; row + 16 <= fullRows && (row + 15) * K + 16 * tiles <= len; row += 16) {
+            for (size_t tile = 0; tile < tiles; tile++) {
+                __m128i regs[16];
+                for (size_t i = 0; i < 16; i++) {
+                    regs[i] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + (row + i) * K + 16 * tile));
+                }
+                transpose16x16(regs);
+                for (size_t j = 0; j < 16 && 16 * tile + j < K; j++) {
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(columns[16 * tile + j] + row), regs[j]);
+                }
+            }
+        }
+
+        // Remaining rows (and partial last row) with the scalar kernel
+        unsigned char* tail[maxFixedKeysize];
+        for (size_t c = 0; c < K; c++) tail[c] = columns[c] + row;
+        size_t done = row * K;
+        transposeKernels[K - 1](data + done, len - done, tail);
+    }
+#endif
+
+    void checkKeysize(int keysize) {
+        if (keysize <= 0) {
+            throw std::invalid_argument("Keysize must be positive");
+        }
+    }
+
+} // namespace
+
+
+//=============================================
+// Repeating-key XOR kernel
+// Takes:
+//      in, out - input and output buffers of len bytes
+//      key     - key of keysize bytes
+// Throws:
+//      std::invalid_argument if keysize is not positive
+//=============================================
+
+void repeatingKeyXorKernel(const unsigned char* in, unsigned char* out, size_t len, const unsigned char* key, int keysize) {
+    checkKeysize(keysize);
+    XOR_PROFILE_KERNEL(Kernel::RepeatingKeyXor, len);
+    if (keysize <= maxFixedKeysize)
+        xorKernels[keysize - 1](in, out, len, key);
+    else
+        repeatingKeyXorGeneric(in, out, len, key, keysize);
+}
+
+
+//=============================================
+// Column histogram kernel
+// Takes:
+//      data        - chunk of ciphertext
+//      len         - chunk length
+//      columns     - keysize histograms to add counts to
+//      startColumn - column of data[0] (position of chunk in stream % keysize)
+//=============================================
+
+void columnHistogramKernel(const unsigned char* data, size_t len, ByteHistogram* columns, int keysize, size_t startColumn) {
+    checkKeysize(keysize);
+    XOR_PROFILE_KERNEL(Kernel::Histogram, len);
+    if (keysize <= maxFixedKeysize)
+        histogramKernels[keysize - 1](data, len, columns, startColumn);
+    else
+        columnHistogramGeneric(data, len, columns, keysize, startColumn);
+}
+
+
+//=============================================
+// Transposition kernel
+// Takes:
+//      data    - ciphertext
+//      len     - ciphertext length
+//      columns - keysize output buffers, one per column
+// Note:
+//      With SSE2, keysizes 4..maxFixedKeysize are transposed in registers
+//      16 rows at a time, the rest uses the specialized scalar kernel
+//=============================================
+
+void transposeKernel(const unsigned char* data, size_t len, unsigned char* const* columns, int keysize) {
+    checkKeysize(keysize);
+#ifdef KEYSIZE_KERNELS_SSE2
+    if (keysize >= minSse2TransposeKeysize && keysize <= maxFixedKeysize) {
+        transposeSse2(data, len, columns, keysize);
+        return;
+    }
+#endif
+    if (keysize <= maxFixedKeysize)
+        transposeKernels[keysize - 1](data, len, columns);
+    else
+        transposeGeneric(data, len, columns, keysize);
+}
@@ -0,0 +1,30 @@
+#ifndef KEYSIZE_KERNELS_H
+#define KEYSIZE_KERNELS_H
+
+#include <cstddef>
+#include "column_stats.h"
+
+// ==============================
+// KEYSIZE KERNELS - Hot loops specialized for small fixed keysizes
+//
+// Repeating-key XOR, column histogram and transposition loops are compiled
+// once for every keysize 1..maxFixedKeysize (template on keysize), so the
+// inner loop over one block has a constant trip count, is fully unrolled
+// and keeps the key in registers. A runtime keysize picks its
+// specialization from a jump table, larger keysizes use the generic loop.
+// ==============================
+
+// Largest keysize with a compile-time specialized kernel
+constexpr int maxFixedKeysize = 64;
+
+// out[i] = in[i] ^ key[i % keysize] (in and out may be the same buffer)
+void repeatingKeyXorKernel(const unsigned char* in, unsigned char* out, size_t len, const unsigned char* key, int keysize);
+
+// Adds bytes of data to column histograms, data[0] belongs to column startColumn
+void columnHistogramKernel(const unsigned char* data, size_t len, ByteHistogram* columns, int keysize, size_t startColumn);
+
+// Copies byte i of data to columns[i % keysize][i / keysize] (SSE2 byte shuffles for keysizes 4..64)
+// Each columns[c] must have room for getColumnLength(len, keysize, c) bytes
+void transposeKernel(const unsigned char* data, size_t len, unsigned char* const* columns, int keysize);
+
+#endif // KEYSIZE_KERNELS_H
@@ -0,0 +1,159 @@
+#include "known_plaintext.h"
+#include "allocation_tracker.h"
+#include "instrumentation.h"
+#include <algorithm>
+#include <stdexcept>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define KNOWN_PLAINTEXT_SSE2 1
+#endif
+
+namespace {
+
+    // True if keystream under crib at offset repeats with period keysize (differences[i] = crib[i] ^ crib[i + keysize])
+    bool periodicAt(const unsigned char* bytes, const std::vector<unsigned char>& differences, size_t offset, size_t keysize) {
+        for (size_t i = 0; i < differences.size(); i++) {
+            if ((bytes[offset + i] ^ bytes[offset + i + keysize]) != differences[i]) return false;
+        }
+        return true;
+    }
+}
+
+
+//=============================================
+// Find offsets of a periodic crib
+// Takes:
+//      data    - ciphertext
+//      crib    - known plaintext
+//      keysize - tested keysize
+// Returns:
+//      Every offset o (ascending) where the keystream data[o + i] ^ crib[i]
+//      satisfies k[i] == k[i + keysize] over the whole crib
+// Throws:
+//      std::invalid_argument if keysize isn't positive or crib is shorter
+//      than keysize + minCribCheckBytes
+// Note:
+//      O(n) per keysize. The test doesn't involve the key, see known_plaintext.h.
+//      SSE2 build compares the first and the last difference of 16 offsets
+//      per step, the differences between them are checked only for offsets
+//      where both match.
+//=============================================
+
+std::vector<size_t> findPeriodicCribOffsets(std::string_view data, std::string_view crib, int keysize) {
+    if (keysize <= 0) {
+        throw std::invalid_argument("Keysize must be positive");
+    }
+    const size_t period = static_cast<size_t>(keysize);
+    if (crib.size() < period + minCribCheckBytes) {
+        throw std::invalid_argument("Crib must be longer than keysize by minCribCheckBytes");
+    }
+    std::vector<size_t> offsets;
+    if (data.size() < crib.size()) return offsets;
+
+    XOR_STAGE_TIMER(Stage::KeysizeDetection);
+    XOR_ALLOCATION_SCOPE(Stage::KeysizeDetection);
+    XOR_STAGE_COUNT(Stage::KeysizeDetection, StageCounter::Bytes, data.size());
+
+    std::vector<unsigned char> differences(crib.size() - period);
+    for (size_t i = 0; i < differences.size(); i++) {
+        differences[i] = static_cast<unsigned char>(crib[i] ^ crib[i + period]);
+    }
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(data.data());
+    const size_t lastOffset = data.size() - crib.size();
+    const size_t last = differences.size() - 1;
+    size_t o = 0;
+
+#ifdef KNOWN_PLAINTEXT_SSE2
+    const __m128i firstDifference = _mm_set1_epi8(static_cast<char>(differences.front()));
+    const __m128i lastDifference = _mm_set1_epi8(static_cast<char>(differences.back()));
+    for (; o + 15 <= lastOffset; o += 16) {
+        __m128i first = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes + o)),
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes + o + period)));
+        __m128i tail = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes + o + last)),
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes + o + last + period)));
+        unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(_mm_and_si128(
+            _mm_cmpeq_epi8(first, firstDifference), _mm_cmpeq_epi8(tail, lastDifference))));
+        while (mask != 0) {
+            int bit = 0;
+            while (!(mask >> bit & 1)) bit++;
+            mask &= mask - 1;
+            if (periodicAt(bytes, differences, o + bit, period)) offsets.push_back(o + bit);
+        }
+    }
+#endif
+
+    for (; o <= lastOffset; o++) {
+        if (periodicAt(bytes, differences, o, period)) offsets.push_back(o);
+    }
+    return offsets;
+}
+
+
+//=============================================
+// Key from crib
+// Takes:
+//      data    - ciphertext
+//      crib    - known plaintext at offset (at least keysize bytes of it)
+//      offset  - position of the crib in data
+//      keysize - keysize of the key
+// Returns:
+//      Key whose byte i encrypts positions p of data with p % keysize == i
+// Throws:
+//      std::invalid_argument if keysize isn't positive or the first keysize
+//      bytes of the crib don't lie within data
+//=============================================
+
+std::string keyFromCrib(std::string_view data, std::string_view crib, size_t offset, int keysize) {
+    if (keysize <= 0) {
+        throw std::invalid_argument("Keysize must be positive");
+    }
+    const size_t period = static_cast<size_t>(keysize);
+    if (crib.size() < period || offset > data.size() || data.size() - offset < period) {
+        throw std::invalid_argument("Crib must cover one key period within data");
+    }
+    std::string key(period, '\0');
+    for (size_t i = 0; i < period; i++) {
+        key[(offset + i) % period] = static_cast<char>(data[offset + i] ^ crib[i]);
+    }
+    return key;
+}
+
+
+//=============================================
+// Keys under which a crib is in the data
+// Takes:
+//      data    - ciphertext
+//      crib    - known plaintext (keysize + minCribCheckBytes bytes or more)
+//      offset  - position of the crib in data, unknownCribOffset to search all positions
+//      keysize - tested keysize
+// Returns:
+//      Distinct keys from every offset where the crib's keystream repeats with
+//      period keysize, in order of first offset, at most maxCribKeys
+//      (empty if a given offset doesn't fit or isn't periodic)
+// Throws:
+//      std::invalid_argument if crib is too short for keysize (see findPeriodicCribOffsets)
+//=============================================
+
+std::vector<std::string> cribKeys(std::string_view data, std::string_view crib, size_t offset, int keysize) {
+    std::vector<size_t> offsets;
+    if (offset == unknownCribOffset) {
+        offsets = findPeriodicCribOffsets(data, crib, keysize);
+    }
+    else {
+        // Same test as the search, on the window at offset only (empty window if the crib doesn't fit)
+        std::string_view window = offset <= data.size() ? data.substr(offset, crib.size()) : std::string_view();
+        if (!findPeriodicCribOffsets(window, crib, keysize).empty()) {
+            offsets.push_back(offset);
+        }
+    }
+
+    std::vector<std::string> keys;
+    for (size_t o : offsets) {
+        std::string key = keyFromCrib(data, crib, o, keysize);
+        if (std::find(keys.begin(), keys.end(), key) != keys.end()) continue;
+        keys.push_back(std::move(key));
+        if (keys.size() == maxCribKeys) break;
+    }
+    return keys;
+}
@@ -0,0 +1,46 @@
+#ifndef KNOWN_PLAINTEXT_H
+#define KNOWN_PLAINTEXT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// ==============================
+// KNOWN PLAINTEXT - Repeating key recovered from a crib instead of statistics
+//
+// Ciphertext XOR known plaintext (a header, a greeting, a file signature) is
+// the keystream under it. If the crib covers one key period plus a few bytes,
+// the keystream repeats with the keysize and those extra bytes confirm it:
+// the key is read off directly, without keysize ranking or column analysis.
+//
+// When the crib's offset is unknown, a keysize p is tested at every offset o
+// at once: the keystream under the crib has period p exactly when
+// c[o + i] ^ c[o + i + p] == crib[i] ^ crib[i + p] for every i, which doesn't
+// depend on the key. One pass over the data per keysize compares the first
+// and last of these differences for 16 offsets at a time (SSE2) and checks the
+// rest only where both match.
+// ==============================
+
+// Crib offset to search for
+constexpr size_t unknownCribOffset = SIZE_MAX;
+
+// Crib bytes beyond one key period that must repeat the keystream
+constexpr size_t minCribCheckBytes = 4;
+
+// Distinct keys of one keysize handed on to key selection
+constexpr size_t maxCribKeys = 64;
+
+// Offsets o where data[o .. o + crib.size()) XOR crib repeats with period keysize
+// (throws std::invalid_argument unless crib has keysize + minCribCheckBytes bytes)
+std::vector<size_t> findPeriodicCribOffsets(std::string_view data, std::string_view crib, int keysize);
+
+// Key of keysize that decrypts data[offset ..] to crib, rotated so key[0] encrypts data[0]
+std::string keyFromCrib(std::string_view data, std::string_view crib, size_t offset, int keysize);
+
+// Distinct keys of keysize under which crib is in data at offset (or anywhere for unknownCribOffset),
+// at most maxCribKeys of them, in order of their first offset
+std::vector<std::string> cribKeys(std::string_view data, std::string_view crib, size_t offset, int keysize);
+
+#endif // KNOWN_PLAINTEXT_H
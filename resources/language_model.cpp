@@ -0,0 +1,405 @@
+#include "language_model.h"
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+//=============================================
+// Embedded English sample
+// Returns:
+//      A few paragraphs of ordinary English prose (letters, punctuation,
+//      digits and newlines in natural proportions)
+//=============================================
+
+std::string_view englishSampleText() {
+    static const char sample[] =
+        "The old house at the end of the street had been empty for years, and most of the people who lived nearby "
+        "had stopped noticing it. The paint on the front door was cracked, the windows were covered with dust, and "
+        "the garden had turned into a small forest of weeds and wild flowers. Children walking home from school "
+        "would sometimes stop at the gate and tell each other stories about what might be inside, but none of them "
+        "ever went further than the first step of the path.\n"
+        "One morning in early spring, a truck stopped in front of the house and two men began to carry boxes "
+        "through the door. By the afternoon the windows were open, the weeds in the garden had been cut, and "
+        "a woman with grey hair was sitting on the porch with a cup of tea, watching the street as if she had "
+        "always lived there. When a neighbour finally came over to say hello, she smiled and said that she had "
+        "grown up in that house more than sixty years ago, and that she had come back because she wanted to see "
+        "the trees in the garden bloom one more time.\n"
+        "Over the next few weeks she became a familiar sight in the neighbourhood. She walked to the market every "
+        "day, she knew the names of all the dogs, and she always had time to listen. People started to bring her "
+        "small things: bread from the bakery, a basket of apples, a newspaper that someone had already read. In "
+        "return she told them about the town as it used to be, when the river was still used to carry wood to the "
+        "mill, when there were only three cars in the whole valley, and when the school had a single room with one "
+        "teacher for all the children.\n"
+        "It is easy to forget that every place has a history, and that the streets we walk on every day were once "
+        "new to someone else. Most of that history is never written down. It lives in the memory of the people "
+        "who were there, and it disappears with them unless somebody takes the time to ask. The woman in the old "
+        "house seemed to understand this better than anyone. She kept a notebook on the table by the window, and "
+        "whenever someone told her a story about the town, she wrote it down in careful, slow handwriting.\n"
+        "By the end of the summer the notebook was full. She asked the library if they would like to keep it, "
+        "and the librarian, who was not much older than the notebook itself, said that they would be honoured. "
+        "Today it sits on a shelf near the reading room, between a map of the valley from 1890 and a collection "
+        "of photographs of the first bridge. Anyone can open it and read about the winter when the river froze, "
+        "the night the mill burned down, or the summer when it did not rain for ninety days.\n"
+        "Science, in a way, works much like that notebook. Each experiment is a small story about how the world "
+        "behaves, and each result is written down so that others can check it, repeat it and build on it. A single "
+        "measurement may not mean very much on its own, but when thousands of them are collected and compared, "
+        "patterns begin to appear. Those patterns become theories, and the theories allow us to make predictions "
+        "about things we have never seen. The process is slow, and it is often wrong, but it corrects itself over "
+        "time because every claim can be tested again.\n"
+        "Computers have changed the speed of that process more than anything else in the last hundred years. A "
+        "calculation that once took a room full of people several months can now be done in a fraction of a second. "
+        "That does not mean the questions have become easier; it means that we can ask many more of them, and that "
+        "we can afford to be wrong more often on the way to being right. The most important skill is still the same "
+        "as it was for the woman with the notebook: to pay attention, to ask good questions, and to write down what "
+        "you learn so that it is not lost.\n";
+    return std::string_view(sample, sizeof(sample) - 1);
+}
+
+
+namespace {
+
+    // Layout of a model file: header, 256 unigram floats, 65536 bigram floats (host byte order, checked on load)
+    struct ModelFileHeader {
+        char magic[8];
+        uint32_t version;
+        uint32_t byteOrder;         // modelByteOrderMark as written by the saving machine
+        uint32_t unigramEntries;
+        uint32_t bigramEntries;
+        uint64_t reserved;
+    };
+    static_assert(sizeof(ModelFileHeader) == 32, "model file header must stay 32 bytes");
+    static_assert(std::numeric_limits<float>::is_iec559, "model files store IEEE-754 floats");
+
+    constexpr char modelMagic[8] = { 'X', 'O', 'R', 'B', 'L', 'M', '\0', '\0' };
+    constexpr uint32_t modelVersion = 1;
+    constexpr uint32_t modelByteOrderMark = 0x01020304;
+    constexpr size_t modelTableEntries = 256 + 256 * 256;
+
+    // Model over tables in storage (unigram first, then bigram)
+    ByteLanguageModel modelOverTables(const float* tables, std::shared_ptr<const void> storage) {
+        ByteLanguageModel model;
+        model.unigram = tables;
+        model.bigram = tables + 256;
+        model.storage = std::move(storage);
+        return model;
+    }
+}
+
+
+//=============================================
+// Language model trainer constructor
+// Takes:
+//      foldCase - count letters case-insensitively, uppercase letters then
+//                 cost an extra log(0.1) (useful for small English samples)
+//=============================================
+
+ByteLanguageModelTrainer::ByteLanguageModelTrainer(bool foldCase)
+    : foldCase(foldCase), unigramCounts(256, 0), bigramCounts(256 * 256, 0) {
+}
+
+
+//=============================================
+// Add chunk of training corpus
+// Takes:
+//      chunk - next bytes of the corpus
+//=============================================
+
+void ByteLanguageModelTrainer::add(std::string_view chunk) {
+    std::array<unsigned char, 256> fold;
+    for (int b = 0; b < 256; b++) {
+        fold[b] = static_cast<unsigned char>(foldCase ? std::tolower(b) : b);
+    }
+    int previous = lastByte;
+    for (char c : chunk) {
+        unsigned char b = fold[static_cast<unsigned char>(c)];
+        unigramCounts[b]++;
+        if (previous >= 0) bigramCounts[previous * 256 + b]++;
+        previous = b;
+    }
+    lastByte = previous;
+    totalBytes += chunk.size();
+}
+
+
+//=============================================
+// Build language model
+// Returns:
+//      Model with smoothed unigram and bigram log-probabilities
+// Note:
+//      Unseen bytes and pairs get additive smoothing, so every entry is finite.
+//      With foldCase, counts are shared by both cases of a letter and every
+//      uppercase letter costs an extra log(0.1).
+//=============================================
+
+ByteLanguageModel ByteLanguageModelTrainer::build() const {
+    const double unigramSmoothing = 0.1;
+    const double bigramSmoothing = 0.01;
+    const double upperCasePenalty = std::log(0.1);
+
+    auto fold = [&](int c) { return foldCase ? std::tolower(c) : c; };
+    auto penalty = [&](int c) { return foldCase && c >= 'A' && c <= 'Z' ? upperCasePenalty : 0.0; };
+
+    const double unigramTotal = static_cast<double>(totalBytes) + unigramSmoothing * 256;
+    const double bigramTotal = static_cast<double>(totalBytes > 0 ? totalBytes - 1 : 0) + bigramSmoothing * 256 * 256;
+
+    auto tables = std::make_shared<std::vector<float>>(modelTableEntries);
+    float* unigram = tables->data();
+    float* bigram = unigram + 256;
+    for (int a = 0; a < 256; a++) {
+        int fa = fold(a);
+        unigram[a] = static_cast<float>(std::log((unigramCounts[fa] + unigramSmoothing) / unigramTotal) + penalty(a));
+        for (int b = 0; b < 256; b++) {
+            int fb = fold(b);
+            bigram[a * 256 + b] = static_cast<float>(std::log((bigramCounts[fa * 256 + fb] + bigramSmoothing) / bigramTotal) + penalty(a) + penalty(b));
+        }
+    }
+    return modelOverTables(tables->data(), tables);
+}
+
+
+//=============================================
+// Train byte language model
+// Takes:
+//      text - training text
+// Returns:
+//      Model with smoothed unigram and bigram log-probabilities
+// Note:
+//      Counts are collected on lowercased bytes and shared by both cases,
+//      every uppercase letter costs an extra log(0.1). Unseen bytes and
+//      pairs get additive smoothing, so every entry is finite.
+//=============================================
+
+ByteLanguageModel trainByteLanguageModel(std::string_view text) {
+    ByteLanguageModelTrainer trainer(true);
+    trainer.add(text);
+    return trainer.build();
+}
+
+
+//=============================================
+// Save byte language model
+// Takes:
+//      filename - file to write
+//      model    - model to save
+// Throws:
+//      std::runtime_error if the file can't be written
+//=============================================
+
+void saveByteLanguageModel(const std::string& filename, const ByteLanguageModel& model) {
+    std::ofstream file(filename, std::ios::binary);
+    if (!file.is_open()) {
+        throw std::runtime_error("Error: Could not open file " + filename);
+    }
+    ModelFileHeader header{};
+    std::memcpy(header.magic, modelMagic, sizeof(modelMagic));
+    header.version = modelVersion;
+    header.byteOrder = modelByteOrderMark;
+    header.unigramEntries = 256;
+    header.bigramEntries = 256 * 256;
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(model.unigram), 256 * sizeof(float));
+    file.write(reinterpret_cast<const char*>(model.bigram), 256 * 256 * sizeof(float));
+    if (!file) {
+        throw std::runtime_error("Error: Could not write file " + filename);
+    }
+}
+
+
+//=============================================
+// Load byte language model
+// Takes:
+//      filename - file written by saveByteLanguageModel
+// Returns:
+//      Model whose tables point into the mapped file
+// Throws:
+//      std::runtime_error if the file can't be opened, is truncated, or was
+//      written by another format version or byte order
+// Note:
+//      The file is memory-mapped read-only (POSIX), so loading costs no copy and
+//      processes using the same model share its pages. Elsewhere it is read into memory.
+//=============================================
+
+ByteLanguageModel loadByteLanguageModel(const std::string& filename) {
+    const size_t fileSize = sizeof(ModelFileHeader) + modelTableEntries * sizeof(float);
+    std::shared_ptr<const void> storage;
+
+#if defined(__unix__) || defined(__APPLE__)
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Error: Could not open file " + filename);
+    }
+    struct stat info;
+    if (::fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) != fileSize) {
+        ::close(fd);
+        throw std::runtime_error("Error: Invalid language model file " + filename);
+    }
+    void* mapping = ::mmap(nullptr, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED) {
+        throw std::runtime_error("Error: Could not map file " + filename);
+    }
+    storage = std::shared_ptr<const void>(mapping, [fileSize](const void* p) { ::munmap(const_cast<void*>(p), fileSize); });
+#else
+    std::ifstream file(filename, std::ios::binary);
+    if (!file.is_open()) {
+        throw std::runtime_error("Error: Could not open file " + filename);
+    }
+    auto buffer = std::make_shared<std::vector<float>>((fileSize + sizeof(float) - 1) / sizeof(float));
+    file.read(reinterpret_cast<char*>(buffer->data()), fileSize);
+    if (file.gcount() != static_cast<std::streamsize>(fileSize) || file.peek() != std::char_traits<char>::eof()) {
+        throw std::runtime_error("Error: Invalid language model file " + filename);
+    }
+    storage = std::shared_ptr<const void>(buffer, buffer->data());
+#endif
+
+    ModelFileHeader header;
+    std::memcpy(&header, storage.get(), sizeof(header));
+    if (std::memcmp(header.magic, modelMagic, sizeof(modelMagic)) != 0 || header.version != modelVersion
+        || header.byteOrder != modelByteOrderMark || header.unigramEntries != 256 || header.bigramEntries != 256 * 256) {
+        throw std::runtime_error("Error: Invalid language model file " + filename);
+    }
+    const float* tables = reinterpret_cast<const float*>(static_cast<const char*>(storage.get()) + sizeof(ModelFileHeader));
+    return modelOverTables(tables, std::move(storage));
+}
+
+
+//=============================================
+// Default model file name
+// Returns:
+//      Value of XOR_LANGUAGE_MODEL if set, otherwise xor_language_model.bin
+//=============================================
+
+std::string defaultLanguageModelPath() {
+    const char* path = std::getenv("XOR_LANGUAGE_MODEL");
+    return path && *path ? path : "xor_language_model.bin";
+}
+
+
+//=============================================
+// Default model
+// Returns:
+//      Model from the default model file, or trained from the embedded
+//      English sample if there is none (thread-safe lazy init)
+// Throws:
+//      std::runtime_error if the file exists but is invalid, or if
+//      XOR_LANGUAGE_MODEL names a file that can't be opened
+//=============================================
+
+const ByteLanguageModel& defaultLanguageModel() {
+    static const ByteLanguageModel model = [] {
+        const std::string path = defaultLanguageModelPath();
+        const char* variable = std::getenv("XOR_LANGUAGE_MODEL");
+        const bool explicitPath = variable && *variable;
+        if (!explicitPath && !std::ifstream(path).is_open()) return trainByteLanguageModel(englishSampleText());
+        return loadByteLanguageModel(path);
+    }();
+    return model;
+}
+
+
+//=============================================
+// Train quadgram model
+// Takes:
+//      text - training text
+// Returns:
+//      Model with log-probability of every class quadgram
+// Note:
+//      P(q) = 0.9 * count(q) / N + 0.1 * P(c0) * P(c1) * P(c2) * P(c3)
+//      Class unigrams carry the smoothing, so quadgrams never seen in a short
+//      sample still rank by how plausible their classes are
+//=============================================
+
+QuadgramModel trainQuadgramModel(std::string_view text) {
+    enum ByteClassId : unsigned char { Space = 26, Digit = 27, Punctuation = 28, LineBreak = 29, Other = 30 };
+    const double seenWeight = 0.9;
+    const double unigramSmoothing = 0.5;
+
+    QuadgramModel model;
+    for (int b = 0; b < 256; b++) {
+        unsigned char cls = Other;
+        if (b >= 'a' && b <= 'z') cls = static_cast<unsigned char>(b - 'a');
+        else if (b >= 'A' && b <= 'Z') cls = static_cast<unsigned char>(b - 'A');
+        else if (b == ' ') cls = Space;
+        else if (b >= '0' && b <= '9') cls = Digit;
+        else if (b == '\n' || b == '\r' || b == '\t') cls = LineBreak;
+        else if (b < 128 && std::ispunct(b)) cls = Punctuation;
+        model.byteClass[b] = cls;
+    }
+
+    const int classCount = 1 << QuadgramModel::classBits;
+    std::vector<double> classCounts(classCount, 0.0);
+    std::vector<uint32_t> seenQuadgrams;  // index of every quadgram in text, counted after sorting
+    seenQuadgrams.reserve(text.size() >= 4 ? text.size() - 3 : 0);
+    for (size_t i = 0; i < text.size(); i++) {
+        classCounts[model.byteClass[static_cast<unsigned char>(text[i])]]++;
+        if (i + 3 < text.size()) {
+            seenQuadgrams.push_back(static_cast<uint32_t>(QuadgramModel::quadgramIndex(
+                model.byteClass[static_cast<unsigned char>(text[i])],
+                model.byteClass[static_cast<unsigned char>(text[i + 1])],
+                model.byteClass[static_cast<unsigned char>(text[i + 2])],
+                model.byteClass[static_cast<unsigned char>(text[i + 3])])));
+        }
+    }
+
+    std::vector<double> classProb(classCount);
+    std::vector<double> classLogProb(classCount);
+    const double classTotal = static_cast<double>(text.size()) + unigramSmoothing * classCount;
+    for (int c = 0; c < classCount; c++) {
+        classProb[c] = (classCounts[c] + unigramSmoothing) / classTotal;
+        classLogProb[c] = std::log(classProb[c]);
+    }
+    const double quadgramTotal = std::max(1.0, static_cast<double>(text.size() >= 4 ? text.size() - 3 : 0));
+
+    // Unseen quadgrams get the background term only, summed in log space (no log per entry)
+    model.logProb.resize(QuadgramModel::tableSize);
+    const double logBackgroundWeight = std::log(1 - seenWeight);
+    size_t q = 0;
+    for (int c0 = 0; c0 < classCount; c0++) {
+        for (int c1 = 0; c1 < classCount; c1++) {
+            for (int c2 = 0; c2 < classCount; c2++) {
+                const double prefix = logBackgroundWeight + classLogProb[c0] + classLogProb[c1] + classLogProb[c2];
+                for (int c3 = 0; c3 < classCount; c3++) {
+                    model.logProb[q++] = static_cast<float>(prefix + classLogProb[c3]);
+                }
+            }
+        }
+    }
+
+    // Seen quadgrams: one log per distinct quadgram of the text
+    std::sort(seenQuadgrams.begin(), seenQuadgrams.end());
+    for (size_t i = 0; i < seenQuadgrams.size();) {
+        const uint32_t quadgram = seenQuadgrams[i];
+        size_t count = 0;
+        for (; i < seenQuadgrams.size() && seenQuadgrams[i] == quadgram; i++) count++;
+        double background = classProb[(quadgram >> 15) & 31] * classProb[(quadgram >> 10) & 31] * classProb[(quadgram >> 5) & 31] * classProb[quadgram & 31];
+        double p = seenWeight * static_cast<double>(count) / quadgramTotal + (1 - seenWeight) * background;
+        model.logProb[quadgram] = static_cast<float>(std::log(p));
+    }
+    return model;
+}
+
+
+//=============================================
+// Default quadgram model
+// Returns:
+//      Model trained from the embedded English sample (thread-safe lazy init)
+// Note:
+//      Built on the first call (first hill-climb refinement), programs that
+//      never refine a key don't pay for the table
+//=============================================
+
+const QuadgramModel& defaultQuadgramModel() {
+    static const QuadgramModel model = trainQuadgramModel(englishSampleText());
+    return model;
+}
@@ -0,0 +1,107 @@
+#ifndef LANGUAGE_MODEL_H
+#define LANGUAGE_MODEL_H
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// ==============================
+// LANGUAGE MODEL - Byte statistics of English text
+//
+// Log-probability tables used to score candidate plaintext beyond single
+// letter frequencies:
+//  - unigram: log P(byte)
+//  - bigram:  log P(byte1, byte2) for adjacent bytes (256 x 256 table)
+//
+// Default tables are trained from a short English sample embedded in the
+// library. Letters are counted case-insensitively and uppercase gets a small
+// penalty, bytes never seen in the sample keep a smoothed (very low) probability.
+//
+// Models for other kinds of plaintext (logs, JSON, source code) are trained
+// from a corpus and saved to a binary file. If XOR_LANGUAGE_MODEL names such a
+// file, or xor_language_model.bin exists in the working directory, it is
+// memory-mapped on first use and becomes the default model.
+// ==============================
+
+// Tables are read-only views into storage shared by all copies of the model
+// (a heap buffer for trained models, the mapped file for loaded ones)
+struct ByteLanguageModel {
+    const float* unigram = nullptr;         // log P(b), 256 entries
+    const float* bigram = nullptr;          // log P(a, b) at [a * 256 + b], 65536 entries
+    std::shared_ptr<const void> storage;    // keeps the tables alive
+
+    float pair(unsigned char a, unsigned char b) const { return bigram[a * 256 + b]; }
+};
+
+// ==============================
+// Collects byte counts of a corpus fed in chunks of any size
+// ==============================
+class ByteLanguageModelTrainer {
+public:
+    // foldCase: count letters case-insensitively and penalize uppercase (for small English samples)
+    explicit ByteLanguageModelTrainer(bool foldCase = false);
+
+    // Adds next chunk of the corpus (chunks are treated as one continuous text)
+    void add(std::string_view chunk);
+
+    // Smoothed log-probabilities of everything added so far
+    ByteLanguageModel build() const;
+
+    // Number of bytes added so far
+    uint64_t size() const { return totalBytes; }
+
+private:
+    bool foldCase;
+    std::vector<uint64_t> unigramCounts;    // 256 entries
+    std::vector<uint64_t> bigramCounts;     // 65536 entries
+    uint64_t totalBytes = 0;
+    int lastByte = -1;                      // last byte of the previous chunk, -1 before the first one
+};
+
+// ==============================
+// Quadgram model over byte classes: letters (case-insensitive), space, digit,
+// punctuation, line break and "other". Four 5-bit classes form a 20-bit index
+// into a table of log P(quadgram), so one lookup scores four plaintext bytes.
+// ==============================
+struct QuadgramModel {
+    static constexpr int classBits = 5;
+    static constexpr size_t tableSize = size_t{ 1 } << (4 * classBits);
+
+    std::array<unsigned char, 256> byteClass{};     // byte -> class (0-31)
+    std::vector<float> logProb;                     // log P(c0, c1, c2, c3) at quadgramIndex
+
+    static size_t quadgramIndex(unsigned c0, unsigned c1, unsigned c2, unsigned c3) {
+        return (c0 << 15) | (c1 << 10) | (c2 << 5) | c3;
+    }
+};
+
+// English sample text the default model is trained from
+std::string_view englishSampleText();
+
+// Trains unigram and bigram log-probabilities from text (case-folded, see ByteLanguageModelTrainer)
+ByteLanguageModel trainByteLanguageModel(std::string_view text);
+
+// Writes model to a binary file (throws std::runtime_error if it can't be written)
+void saveByteLanguageModel(const std::string& filename, const ByteLanguageModel& model);
+
+// Memory-maps a file written by saveByteLanguageModel (read into memory where mapping isn't available)
+// Throws std::runtime_error if the file can't be opened or isn't a valid model file
+ByteLanguageModel loadByteLanguageModel(const std::string& filename);
+
+// Model file loaded on first use (see defaultLanguageModelPath), or one trained from
+// englishSampleText() if there is none
+const ByteLanguageModel& defaultLanguageModel();
+
+// Name of the default model file (XOR_LANGUAGE_MODEL or xor_language_model.bin)
+std::string defaultLanguageModelPath();
+
+// Trains quadgram log-probabilities from text (interpolated with class unigrams for unseen quadgrams)
+QuadgramModel trainQuadgramModel(std::string_view text);
+
+// Quadgram model trained from englishSampleText(), built on first use
+const QuadgramModel& defaultQuadgramModel();
+
+#endif // LANGUAGE_MODEL_H
@@ -0,0 +1,269 @@
+#include "pair_scoring.h"
+#include "allocation_tracker.h"
+#include "instrumentation.h"
+#include "key_refinement.h"
+#include <algorithm>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+
+// AVX2 kernels are built into every x86 build: with GCC/Clang they are compiled
+// for AVX2 as single functions and picked at run time if the CPU supports it
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define PAIR_SCORING_AVX2 1
+#define PAIR_SCORING_AVX2_TARGET
+#elif (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define PAIR_SCORING_AVX2 1
+#define PAIR_SCORING_AVX2_TARGET __attribute__((target("avx2")))
+#endif
+
+namespace {
+
+#ifdef PAIR_SCORING_AVX2
+    // True if the AVX2 kernels may run on this CPU
+    bool avx2Supported() {
+#if defined(__AVX2__)
+        return true;
+#else
+        static const bool supported = [] {
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("avx2") != 0;
+        }();
+        return supported;
+#endif
+    }
+
+    // Sum of whole blocks of 8 pairs from i on, i is left at the first pair not added
+    PAIR_SCORING_AVX2_TARGET double pairTableScoreAVX2(const uint16_t* pairs, size_t count, const float* table, unsigned keyPair, size_t& i) {
+        double score = 0;
+        const __m256i key = _mm256_set1_epi32(static_cast<int>(keyPair));
+        while (i + 8 <= count) {
+            const size_t blockEnd = std::min(count, i + 1024);
+            __m256 sum = _mm256_setzero_ps();
+            for (; i + 8 <= blockEnd; i += 8) {
+                __m128i packed = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pairs + i));
+                __m256i index = _mm256_xor_si256(_mm256_cvtepu16_epi32(packed), key);
+                sum = _mm256_add_ps(sum, _mm256_i32gather_ps(table, index, 4));
+            }
+            alignas(32) float lanes[8];
+            _mm256_store_ps(lanes, sum);
+            for (float lane : lanes) score += lane;
+        }
+        return score;
+    }
+
+    // Keys k0..k0+7 (k0 a multiple of 8) decode byte b to the 8 table entries starting
+    // at (b ^ k0) & ~7, in the order of lane ^ (b & 7): one load and one permute per 8 keys
+    PAIR_SCORING_AVX2_TARGET void unigramKeyScoresAVX2(const ByteHistogram& hist, const float* unigram, double* scores) {
+        const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+        for (int b = 0; b < 256; b++) {
+            if (hist[b] == 0) continue;
+            const __m256d weight = _mm256_set1_pd(static_cast<double>(hist[b]));
+            const __m256i order = _mm256_xor_si256(lanes, _mm256_set1_epi32(b & 7));
+            for (int k0 = 0; k0 < 256; k0 += 8) {
+                __m256 entries = _mm256_permutevar8x32_ps(_mm256_loadu_ps(unigram + ((b ^ k0) & ~7)), order);
+                __m256d low = _mm256_mul_pd(weight, _mm256_cvtps_pd(_mm256_castps256_ps128(entries)));
+                __m256d high = _mm256_mul_pd(weight, _mm256_cvtps_pd(_mm256_extractf128_ps(entries, 1)));
+                _mm256_storeu_pd(scores + k0, _mm256_add_pd(_mm256_loadu_pd(scores + k0), low));
+                _mm256_storeu_pd(scores + k0 + 4, _mm256_add_pd(_mm256_loadu_pd(scores + k0 + 4), high));
+            }
+        }
+    }
+#endif
+}
+
+//=============================================
+// Pair indices of a column boundary
+// Takes:
+//      data    - ciphertext
+//      keysize - tested keysize
+//      column  - column of the first byte of each pair
+// Returns:
+//      (c[p] << 8) | c[p + 1] for every p in column with p + 1 in data
+//=============================================
+
+std::vector<uint16_t> boundaryPairIndices(std::string_view data, int keysize, int column) {
+    if (keysize <= 0 || column < 0 || column >= keysize) {
+        throw std::invalid_argument("Column must be within keysize");
+    }
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(data.data());
+    std::vector<uint16_t> pairs;
+    if (data.size() > static_cast<size_t>(column) + 1) {
+        pairs.reserve((data.size() - column - 2) / keysize + 1);
+    }
+    for (size_t p = column; p + 1 < data.size(); p += keysize) {
+        pairs.push_back(static_cast<uint16_t>(bytes[p] << 8 | bytes[p + 1]));
+    }
+    return pairs;
+}
+
+
+//=============================================
+// Table score of a key pair
+// Takes:
+//      pairs   - pair indices (see boundaryPairIndices)
+//      count   - number of pairs
+//      table   - 65536 log-probabilities, bigram table of ByteLanguageModel
+//      keyPair - (keyA << 8) | keyB
+// Returns:
+//      Sum of table[pairs[i] ^ keyPair]
+// Note:
+//      On CPUs with AVX2 8 entries are gathered per step into float lanes,
+//      which are added to the double total every 1024 pairs so long inputs
+//      don't lose precision. Otherwise 4 independent scalar sums are kept.
+//=============================================
+
+double pairTableScore(const uint16_t* pairs, size_t count, const float* table, unsigned keyPair) {
+    keyPair &= 0xFFFF;
+    double score = 0;
+    size_t i = 0;
+#ifdef PAIR_SCORING_AVX2
+    if (avx2Supported()) {
+        score = pairTableScoreAVX2(pairs, count, table, keyPair, i);
+    }
+    else
+#endif
+    {
+        double sums[4] = { 0, 0, 0, 0 };
+        for (; i + 4 <= count; i += 4) {
+            sums[0] += table[pairs[i] ^ keyPair];
+            sums[1] += table[pairs[i + 1] ^ keyPair];
+            sums[2] += table[pairs[i + 2] ^ keyPair];
+            sums[3] += table[pairs[i + 3] ^ keyPair];
+        }
+        score = (sums[0] + sums[1]) + (sums[2] + sums[3]);
+    }
+    for (; i < count; i++) {
+        score += table[pairs[i] ^ keyPair];
+    }
+    return score;
+}
+
+
+//=============================================
+// Unigram scores of every key
+// Takes:
+//      hist    - byte histogram of encrypted column
+//      unigram - 256 log-probabilities, unigram table of ByteLanguageModel
+//      scores  - 256 sums, scores[k] += hist[b] * unigram[b ^ k] for every b
+// Note:
+//      Only bytes present in the column are visited. With AVX2 the 256 keys
+//      take 32 loads and permutes per byte instead of 256 indexed loads,
+//      products and sums are the same as in the scalar loop.
+//=============================================
+
+void unigramKeyScores(const ByteHistogram& hist, const float* unigram, double* scores) {
+#ifdef PAIR_SCORING_AVX2
+    if (avx2Supported()) {
+        unigramKeyScoresAVX2(hist, unigram, scores);
+        return;
+    }
+#endif
+    for (int b = 0; b < 256; b++) {
+        if (hist[b] == 0) continue;
+        const double weight = static_cast<double>(hist[b]);
+        for (int key = 0; key < 256; key++) {
+            scores[key] += weight * unigram[b ^ key];
+        }
+    }
+}
+
+
+//=============================================
+// Bigram fit of a keysize
+// Takes:
+//      data    - ciphertext
+//      keysize - tested keysize
+//      model   - byte language model
+// Returns:
+//      Average log-probability per byte pair, every boundary (i, i + 1)
+//      decrypted with its best pair among the top keysizePairCandidates
+//      unigram candidates of both columns (lowest float if data has no pair)
+// Note:
+//      Only the right keysize (or its multiples) decrypts every pair with a
+//      consistent key pair, wrong ones leave pairs no key pair fits
+//=============================================
+
+double keysizeBigramFit(std::string_view data, int keysize, const ByteLanguageModel& model) {
+    if (keysize <= 0) {
+        throw std::invalid_argument("Keysize must be positive");
+    }
+    // Columns of long keysizes hold a few bytes each: one histogram is filled
+    // and cleared per column instead of building all of them
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(data.data());
+    ByteHistogram column{};
+    std::vector<std::vector<int>> candidates(keysize);
+    for (int c = 0; c < keysize; c++) {
+        for (size_t p = c; p < data.size(); p += keysize) column[bytes[p]]++;
+        candidates[c] = topColumnKeys(column, model, keysizePairCandidates);
+        for (size_t p = c; p < data.size(); p += keysize) column[bytes[p]] = 0;
+    }
+    double total = 0;
+    size_t pairCount = 0;
+    for (int c = 0; c < keysize; c++) {
+        auto pairs = boundaryPairIndices(data, keysize, c);
+        if (pairs.empty()) continue;
+        double best = std::numeric_limits<double>::lowest();
+        for (int keyA : candidates[c]) {
+            for (int keyB : candidates[(c + 1) % keysize]) {
+                best = std::max(best, pairTableScore(pairs.data(), pairs.size(), model.bigram, static_cast<unsigned>(keyA << 8 | keyB)));
+            }
+        }
+        total += best;
+        pairCount += pairs.size();
+    }
+    return pairCount != 0 ? total / pairCount : std::numeric_limits<double>::lowest();
+}
+
+
+//=============================================
+// Rank keysizes by bigram fit
+// Takes:
+//      data       - ciphertext
+//      minKeysize - minimal keysize to try
+//      maxKeysize - maximal keysize to try (lowered so columns keep minBigramColumnLength bytes)
+//      noOfKeys   - number of keysizes to return
+//      model      - byte language model
+// Returns:
+//      Keysizes sorted by keysizeBigramFit, best first, except that a
+//      keysize within bigramMultipleTolerance of its multiple goes ahead of it
+//=============================================
+
+std::vector<int> rankKeysizesByBigrams(std::string_view data, int minKeysize, int maxKeysize, int noOfKeys, const ByteLanguageModel& model) {
+    minKeysize = std::max(minKeysize, 1);
+    maxKeysize = static_cast<int>(std::min<size_t>(std::max(maxKeysize, 0), data.size() / minBigramColumnLength));
+    if (maxKeysize < minKeysize || noOfKeys <= 0) return {};
+
+    XOR_STAGE_TIMER(Stage::KeysizeDetection);
+    XOR_ALLOCATION_SCOPE(Stage::KeysizeDetection);
+    XOR_STAGE_COUNT(Stage::KeysizeDetection, StageCounter::Bytes, data.size() * (maxKeysize - minKeysize + 1));
+
+    struct Fit {
+        int keysize;
+        double perPair;
+    };
+    std::vector<Fit> fits;
+    for (int keysize = minKeysize; keysize <= maxKeysize; keysize++) {
+        fits.push_back({ keysize, keysizeBigramFit(data, keysize, model) });
+    }
+    std::stable_sort(fits.begin(), fits.end(), [](const Fit& a, const Fit& b) {
+        return a.perPair > b.perPair;
+        });
+
+    for (size_t i = 0; i < fits.size(); i++) {
+        for (size_t j = i + 1; j < fits.size(); j++) {
+            if (fits[i].keysize % fits[j].keysize == 0 && fits[j].perPair >= fits[i].perPair - bigramMultipleTolerance) {
+                std::rotate(fits.begin() + i, fits.begin() + j, fits.begin() + j + 1);
+                j = i;      // recheck later keysizes against the divisor now at i
+            }
+        }
+    }
+
+    std::vector<int> keysizes;
+    for (size_t i = 0; i < fits.size() && keysizes.size() < static_cast<size_t>(noOfKeys); i++) {
+        keysizes.push_back(fits[i].keysize);
+    }
+    return keysizes;
+}
@@ -0,0 +1,214 @@
+#include "perf_counters.h"
+#include <atomic>
+#include <cstdio>
+#include <sstream>
+
+#if defined(__linux__)
+#include <cstring>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#define PERF_COUNTERS_LINUX
+#endif
+
+namespace {
+    constexpr size_t kernelSlots = static_cast<size_t>(Kernel::Count);
+    constexpr int eventCount = 4;
+
+    struct KernelTotals {
+        std::atomic<uint64_t> calls{ 0 };
+        std::atomic<uint64_t> bytes{ 0 };
+        std::atomic<uint64_t> events[eventCount]{};
+    };
+
+    std::atomic<bool> profiling{ false };
+    KernelTotals totals[kernelSlots];
+
+#ifdef PERF_COUNTERS_LINUX
+    // Counter group of one thread: cycles (leader), instructions, cache misses, branch misses
+    class ThreadCounters {
+    public:
+        ThreadCounters() {
+            const uint64_t configs[eventCount] = {
+                PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+                PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES };
+            for (int e = 0; e < eventCount; e++) {
+                perf_event_attr attr;
+                std::memset(&attr, 0, sizeof(attr));
+                attr.type = PERF_TYPE_HARDWARE;
+                attr.size = sizeof(attr);
+                attr.config = configs[e];
+                attr.disabled = e == 0 ? 1 : 0;     // group starts when leader is enabled
+                attr.exclude_kernel = 1;
+                attr.exclude_hv = 1;
+                attr.read_format = PERF_FORMAT_GROUP;
+                fds[e] = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, e == 0 ? -1 : fds[0], 0));
+                if (fds[e] < 0) return;
+            }
+            ioctl(fds[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+            ioctl(fds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+            valid = true;
+        }
+
+        ~ThreadCounters() {
+            for (int fd : fds) {
+                if (fd >= 0) close(fd);
+            }
+        }
+
+        // Current values of all events, false if counters aren't available
+        bool read(uint64_t* values) const {
+            if (!valid) return false;
+            struct { uint64_t count; uint64_t values[eventCount]; } group;
+            if (::read(fds[0], &group, sizeof(group)) != static_cast<ssize_t>(sizeof(group))) return false;
+            for (int e = 0; e < eventCount; e++) values[e] = group.values[e];
+            return true;
+        }
+
+        bool available() const { return valid; }
+
+    private:
+        int fds[eventCount] = { -1, -1, -1, -1 };
+        bool valid = false;
+    };
+
+    ThreadCounters& threadCounters() {
+        thread_local ThreadCounters counters;
+        return counters;
+    }
+#endif
+
+    bool readCounters(uint64_t* values) {
+#ifdef PERF_COUNTERS_LINUX
+        return threadCounters().read(values);
+#else
+        (void)values;
+        return false;
+#endif
+    }
+}
+
+
+//=============================================
+// Kernel names
+//=============================================
+
+const char* kernelName(Kernel kernel) {
+    switch (kernel) {
+    case Kernel::HexDecode: return "hex_decode";
+    case Kernel::Base64Decode: return "base64_decode";
+    case Kernel::Histogram: return "histogram";
+    case Kernel::Hamming: return "hamming";
+    case Kernel::KeyScoring: return "key_scoring";
+    case Kernel::RepeatingKeyXor: return "repeating_key_xor";
+    default: return "unknown";
+    }
+}
+
+
+//=============================================
+// Enable / disable profiling
+// Takes:
+//      enabled - profile kernel calls from now on
+// Returns:
+//      true if profiling is in the requested state
+// Note:
+//      Availability is checked by opening counters for the calling thread,
+//      other threads open their own counters on their first profiled call
+//=============================================
+
+bool setPerfProfilingEnabled(bool enabled) {
+    if (enabled) {
+#ifdef PERF_COUNTERS_LINUX
+        if (!threadCounters().available()) return false;
+#else
+        return false;
+#endif
+    }
+    profiling.store(enabled, std::memory_order_relaxed);
+    return true;
+}
+
+bool perfProfilingEnabled() {
+    return profiling.load(std::memory_order_relaxed);
+}
+
+
+//=============================================
+// Kernel totals
+//=============================================
+
+KernelPerfStats kernelPerfStats(Kernel kernel) {
+    const KernelTotals& t = totals[static_cast<size_t>(kernel)];
+    KernelPerfStats stats;
+    stats.calls = t.calls.load(std::memory_order_relaxed);
+    stats.bytes = t.bytes.load(std::memory_order_relaxed);
+    stats.cycles = t.events[0].load(std::memory_order_relaxed);
+    stats.instructions = t.events[1].load(std::memory_order_relaxed);
+    stats.cacheMisses = t.events[2].load(std::memory_order_relaxed);
+    stats.branchMisses = t.events[3].load(std::memory_order_relaxed);
+    return stats;
+}
+
+void resetPerfStats() {
+    for (auto& t : totals) {
+        t.calls.store(0, std::memory_order_relaxed);
+        t.bytes.store(0, std::memory_order_relaxed);
+        for (auto& e : t.events) e.store(0, std::memory_order_relaxed);
+    }
+}
+
+
+//=============================================
+// Profile report
+// Returns:
+//      One line per kernel with at least one call
+// Note:
+//      Cache and branch misses are given per 1000 instructions (MPKI)
+//=============================================
+
+std::string perfProfileReport() {
+    std::ostringstream out;
+    char line[256];
+    std::snprintf(line, sizeof(line), "%-18s %10s %14s %14s %6s %11s %10s %11s\n",
+        "kernel", "calls", "bytes", "cycles", "IPC", "bytes/cycle", "cache MPKI", "branch MPKI");
+    out << line;
+    for (size_t k = 0; k < kernelSlots; k++) {
+        KernelPerfStats stats = kernelPerfStats(static_cast<Kernel>(k));
+        if (stats.calls == 0) continue;
+        const double kiloInstructions = stats.instructions / 1000.0;
+        std::snprintf(line, sizeof(line), "%-18s %10llu %14llu %14llu %6.2f %11.3f %10.2f %11.2f\n",
+            kernelName(static_cast<Kernel>(k)),
+            static_cast<unsigned long long>(stats.calls), static_cast<unsigned long long>(stats.bytes),
+            static_cast<unsigned long long>(stats.cycles), stats.instructionsPerCycle(), stats.bytesPerCycle(),
+            kiloInstructions > 0 ? stats.cacheMisses / kiloInstructions : 0.0,
+            kiloInstructions > 0 ? stats.branchMisses / kiloInstructions : 0.0);
+        out << line;
+    }
+    return out.str();
+}
+
+
+//=============================================
+// Kernel call profile
+// Takes:
+//      kernel - profiled kernel
+//      bytes  - input bytes the call processes
+//=============================================
+
+KernelProfile::KernelProfile(Kernel kernel, uint64_t bytes) : kernel(kernel), bytes(bytes) {
+    if (profiling.load(std::memory_order_relaxed)) active = readCounters(start);
+}
+
+KernelProfile::~KernelProfile() {
+    if (!active) return;
+    uint64_t end[eventCount];
+    if (!readCounters(end)) return;
+    KernelTotals& t = totals[static_cast<size_t>(kernel)];
+    t.calls.fetch_add(1, std::memory_order_relaxed);
+    t.bytes.fetch_add(bytes, std::memory_order_relaxed);
+    for (int e = 0; e < eventCount; e++) {
+        t.events[e].fetch_add(end[e] - start[e], std::memory_order_relaxed);
+    }
+}
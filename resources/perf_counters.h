@@ -0,0 +1,86 @@
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+#include <cstdint>
+#include <string>
+
+// ==============================
+// PERF COUNTERS - Hardware performance counters of hot kernels (Linux)
+//
+// In profiling mode every call of a hot kernel is bracketed by reads of
+// the calling thread's perf_event_open counter group: cycles, instructions,
+// cache misses and branch misses (user space only). Totals per kernel give
+// IPC and bytes per cycle, telling compute-, memory- and branch-bound
+// kernels apart without attaching an external profiler.
+//
+// Profiling is off by default and costs one relaxed atomic load per kernel
+// call then. On other systems, or when the kernel refuses perf events
+// (perf_event_paranoid, containers without a PMU), it can't be enabled.
+// Defining XOR_DISABLE_PERF_COUNTERS removes the call sites.
+//
+// A counter read is a system call, so kernels called on tiny inputs are
+// measured with noticeable overhead of the reads themselves.
+// ==============================
+
+enum class Kernel {
+    HexDecode,
+    Base64Decode,
+    Histogram,          // column histogram kernel
+    Hamming,
+    KeyScoring,         // all 256 single-byte keys of one column
+    RepeatingKeyXor,
+    Count
+};
+
+struct KernelPerfStats {
+    uint64_t calls = 0;
+    uint64_t bytes = 0;
+    uint64_t cycles = 0;
+    uint64_t instructions = 0;
+    uint64_t cacheMisses = 0;
+    uint64_t branchMisses = 0;
+
+    double instructionsPerCycle() const { return cycles ? static_cast<double>(instructions) / cycles : 0.0; }
+    double bytesPerCycle() const { return cycles ? static_cast<double>(bytes) / cycles : 0.0; }
+};
+
+// Short kernel name used in reports
+const char* kernelName(Kernel kernel);
+
+// Turns profiling on (returns false if perf counters aren't available) or off
+bool setPerfProfilingEnabled(bool enabled);
+bool perfProfilingEnabled();
+
+// Totals of a kernel over all threads since the last reset
+KernelPerfStats kernelPerfStats(Kernel kernel);
+void resetPerfStats();
+
+// Table of all profiled kernels: calls, bytes, cycles, IPC, bytes/cycle, miss rates
+std::string perfProfileReport();
+
+// Counts one kernel call from construction to destruction (if profiling was enabled at construction)
+class KernelProfile {
+public:
+    KernelProfile(Kernel kernel, uint64_t bytes);
+    ~KernelProfile();
+
+    KernelProfile(const KernelProfile&) = delete;
+    KernelProfile& operator=(const KernelProfile&) = delete;
+
+private:
+    Kernel kernel;
+    uint64_t bytes;
+    bool active = false;
+    uint64_t start[4] = {};     // cycles, instructions, cache misses, branch misses
+};
+
+#define XOR_PERF_CONCAT_(a, b) a##b
+#define XOR_PERF_CONCAT(a, b) XOR_PERF_CONCAT_(a, b)
+
+#ifdef XOR_DISABLE_PERF_COUNTERS
+#define XOR_PROFILE_KERNEL(kernel, bytes) ((void)0)
+#else
+#define XOR_PROFILE_KERNEL(kernel, bytes) KernelProfile XOR_PERF_CONCAT(kernelProfile_, __LINE__)(kernel, bytes)
+#endif
+
+#endif // PERF_COUNTERS_H
@@ -0,0 +1,100 @@
+#include "streaming_breaker.h"
+#include <algorithm>
+#include <stdexcept>
+#include "key_refinement.h"
+#include "keysize_kernels.h"
+#include "language_model.h"
+
+//=============================================
+// Streaming breaker constructor
+// Takes:
+//      minKeysize, maxKeysize - inclusive keysize search range
+// Throws:
+//      std::invalid_argument if range is empty or not positive
+//=============================================
+
+StreamingKeyBreaker::StreamingKeyBreaker(int minKeysize, int maxKeysize)
+    : histograms(keysizeRange(minKeysize, maxKeysize)) {
+    if (minKeysize <= 0 || maxKeysize < minKeysize) {
+        throw std::invalid_argument("Invalid keysize range");
+    }
+}
+
+
+//=============================================
+// Append chunk of ciphertext
+// Takes:
+//      chunk - next bytes of the stream
+// Note:
+//      Only histograms are updated, analysis is redone on next query
+//=============================================
+
+void StreamingKeyBreaker::append(std::string_view chunk) {
+    histograms.append(chunk);
+}
+
+
+//=============================================
+// Analysis of data received so far
+// Returns:
+//      Cached result, recomputed if data was appended since last query
+// Note:
+//      Keysize is the top IC ranked one, every key byte is the most likely
+//      one under the unigram model. Keysizes whose columns would hold less
+//      than 2 bytes are not ranked yet.
+//=============================================
+
+const StreamingKeyBreaker::Result& StreamingKeyBreaker::result() const {
+    if (cached.analyzedBytes == histograms.size()) return cached;
+
+    Result fresh;
+    fresh.analyzedBytes = histograms.size();
+    std::vector<int> ranked = rankKeysizesByCoincidence(histograms, 1);
+    if (!ranked.empty() && histograms.size() >= 2 * static_cast<uint64_t>(ranked[0])) {
+        const ByteLanguageModel& model = defaultLanguageModel();
+        const auto& columns = histograms.columns(ranked[0]);
+        fresh.keysize = ranked[0];
+        for (const auto& hist : columns) {
+            fresh.key += static_cast<char>(topColumnKeys(hist, model, 1)[0]);
+        }
+        double keysizeCertainty = std::min(1.0, keysizeMargin(histograms, fresh.keysize) / confidentKeysizeMargin);
+        fresh.confidence = keyPosterior(columns, fresh.key, model) * keysizeCertainty;
+    }
+    cached = std::move(fresh);
+    return cached;
+}
+
+int StreamingKeyBreaker::keysize() const {
+    return result().keysize;
+}
+
+std::string StreamingKeyBreaker::bestKey() const {
+    return result().key;
+}
+
+double StreamingKeyBreaker::confidence() const {
+    return result().confidence;
+}
+
+
+//=============================================
+// Decrypt part of the stream with current key
+// Takes:
+//      chunk        - ciphertext bytes
+//      streamOffset - position of chunk[0] in the stream
+// Returns:
+//      Decrypted chunk (unchanged if no key is known yet)
+//=============================================
+
+std::string StreamingKeyBreaker::decrypt(std::string_view chunk, uint64_t streamOffset) const {
+    std::string decrypted(chunk);
+    const std::string& key = result().key;
+    if (key.empty()) return decrypted;
+
+    // Rotate key so that key[0] lines up with chunk[0]
+    size_t shift = static_cast<size_t>(streamOffset % key.size());
+    std::string rotated = key.substr(shift) + key.substr(0, shift);
+    unsigned char* bytes = reinterpret_cast<unsigned char*>(decrypted.data());
+    repeatingKeyXorKernel(bytes, bytes, decrypted.size(), reinterpret_cast<const unsigned char*>(rotated.data()), static_cast<int>(rotated.size()));
+    return decrypted;
+}
@@ -0,0 +1,57 @@
+#ifndef STREAMING_BREAKER_H
+#define STREAMING_BREAKER_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include "column_stats.h"
+
+// ==============================
+// STREAMING BREAKER - Incremental repeating-key XOR breaking
+//
+// Accepts ciphertext in appended chunks. Each chunk only updates the column
+// histograms of all candidate keysizes (O(chunk)). Keysize ranking and key
+// extraction run on the histograms when a result is requested, so their cost
+// depends on the keysize range, not on how much data has arrived.
+//
+// Not thread-safe: one instance is fed and queried from one thread.
+// ==============================
+
+class StreamingKeyBreaker {
+public:
+    StreamingKeyBreaker(int minKeysize, int maxKeysize);
+
+    // Adds next chunk of the ciphertext stream
+    void append(std::string_view chunk);
+
+    // Current best keysize (0 before enough data arrived)
+    int keysize() const;
+
+    // Current best key (empty before enough data arrived)
+    std::string bestKey() const;
+
+    // Confidence (0-1) in current key: probability that every key byte is right
+    // under the unigram model, scaled down while keysize margin is below confidentKeysizeMargin
+    double confidence() const;
+
+    // Decrypts bytes that start at given offset of the stream with current key
+    std::string decrypt(std::string_view chunk, uint64_t streamOffset) const;
+
+    // Total bytes appended so far
+    uint64_t size() const { return histograms.size(); }
+
+private:
+    struct Result {
+        uint64_t analyzedBytes = 0;
+        int keysize = 0;
+        std::string key;
+        double confidence = 0;
+    };
+
+    const Result& result() const;
+
+    KeysizeHistograms histograms;
+    mutable Result cached;      // analysis of the first cached.analyzedBytes bytes
+};
+
+#endif // STREAMING_BREAKER_H
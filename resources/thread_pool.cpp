@@ -0,0 +1,162 @@
+#include "thread_pool.h"
+#include "allocation_tracker.h"
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <memory>
+
+namespace {
+    // Set while a SerialScope is alive on this thread
+    thread_local bool serialThread = false;
+}
+
+//=============================================
+// Thread pool constructor
+// Takes:
+//      threadCount - number of worker threads to start
+//=============================================
+
+ThreadPool::ThreadPool(unsigned threadCount) {
+    workers.reserve(threadCount);
+    for (unsigned i = 0; i < threadCount; i++) {
+        workers.emplace_back([this] { workerLoop(); });
+    }
+}
+
+
+//=============================================
+// Thread pool destructor
+// Note:
+//      Workers finish already queued jobs before they are joined
+//=============================================
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(jobsMutex);
+        stopping = true;
+    }
+    jobsAvailable.notify_all();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+
+//=============================================
+// Worker thread main loop
+//=============================================
+
+void ThreadPool::workerLoop() {
+    for (;;) {
+        std::function<void()> job;
+        {
+            std::unique_lock<std::mutex> lock(jobsMutex);
+            jobsAvailable.wait(lock, [this] { return stopping || !jobs.empty(); });
+            if (jobs.empty()) return;   // stopping and nothing left to do
+            job = std::move(jobs.front());
+            jobs.pop_front();
+        }
+        job();
+    }
+}
+
+void ThreadPool::enqueue(std::function<void()> job) {
+    {
+        std::lock_guard<std::mutex> lock(jobsMutex);
+        jobs.push_back(std::move(job));
+    }
+    jobsAvailable.notify_one();
+}
+
+
+//=============================================
+// Parallel loop
+// Takes:
+//      count - number of iterations
+//      task  - function called once for every index in [0, count)
+// Throws:
+//      First exception thrown by any task (remaining indices are skipped)
+// Note:
+//      Iterations are handed out one by one from a shared counter. Helper jobs
+//      that start after the loop is drained find nothing to do and exit, so
+//      the caller never waits on a job that hasn't started.
+//      Inside a SerialScope the loop runs on the calling thread only.
+//      Workers account their allocations to the caller's allocation stage.
+//=============================================
+
+void ThreadPool::parallelFor(size_t count, const std::function<void(size_t)>& task) {
+    if (count == 0) return;
+    if (serialThread) {
+        for (size_t i = 0; i < count; i++) {
+            task(i);
+        }
+        return;
+    }
+
+    struct LoopState {
+        std::atomic<size_t> next{ 0 };
+        std::atomic<size_t> finished{ 0 };
+        std::atomic<bool> failed{ false };
+        std::exception_ptr error;
+        std::mutex doneMutex;
+        std::condition_variable done;
+    };
+    auto state = std::make_shared<LoopState>();
+
+    const Stage callerStage = currentAllocationStage();
+    auto drain = [state, count, callerStage, &task] {
+        AllocationScope allocationScope(callerStage);
+        for (size_t i = state->next++; i < count; i = state->next++) {
+            if (!state->failed) {
+                try {
+                    task(i);
+                }
+                catch (...) {
+                    std::lock_guard<std::mutex> lock(state->doneMutex);
+                    if (!state->failed.exchange(true)) state->error = std::current_exception();
+                }
+            }
+            if (++state->finished == count) {
+                std::lock_guard<std::mutex> lock(state->doneMutex);
+                state->done.notify_all();
+            }
+        }
+    };
+
+    size_t helpers = std::min<size_t>(workers.size(), count - 1);
+    for (size_t i = 0; i < helpers; i++) {
+        enqueue(drain);
+    }
+    drain();
+
+    std::unique_lock<std::mutex> lock(state->doneMutex);
+    state->done.wait(lock, [&] { return state->finished == count; });
+    if (state->error) std::rethrow_exception(state->error);
+}
+
+
+//=============================================
+// Shared default pool
+// Returns:
+//      Pool sized to hardware concurrency, created on first use
+//=============================================
+
+ThreadPool& defaultThreadPool() {
+    static ThreadPool pool(std::max(1u, std::thread::hardware_concurrency()) - 1);
+    return pool;
+}
+
+
+//=============================================
+// Serial scope
+// Note:
+//      Scopes may nest, the destructor restores state of the enclosing one
+//=============================================
+
+SerialScope::SerialScope() : previous(serialThread) {
+    serialThread = true;
+}
+
+SerialScope::~SerialScope() {
+    serialThread = previous;
+}
@@ -0,0 +1,67 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// ==============================
+// THREAD POOL - Fixed set of worker threads for data-parallel loops
+//
+// parallelFor splits a loop of independent iterations between the workers
+// and the calling thread. The caller always works on the loop itself, so
+// parallelFor may be called from inside another parallelFor task without
+// deadlocking (e.g. keysizes in parallel, columns of each keysize in parallel).
+// ==============================
+class ThreadPool {
+public:
+    // Starts threadCount workers (0 == run everything on calling thread)
+    explicit ThreadPool(unsigned threadCount);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Runs task(i) for every i in [0, count) and returns when all calls finished
+    // First exception thrown by a task is rethrown in the calling thread
+    void parallelFor(size_t count, const std::function<void(size_t)>& task);
+
+    // Number of worker threads (not counting the caller)
+    unsigned size() const { return static_cast<unsigned>(workers.size()); }
+
+private:
+    void workerLoop();
+    void enqueue(std::function<void()> job);
+
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> jobs;
+    std::mutex jobsMutex;
+    std::condition_variable jobsAvailable;
+    bool stopping = false;
+};
+
+// Process-wide pool with one worker less than hardware threads (caller is the last one)
+ThreadPool& defaultThreadPool();
+
+// ==============================
+// While a SerialScope is alive, parallelFor called from its thread runs every
+// iteration on that thread. For callers that already keep all threads busy
+// with independent work, where splitting small loops would only add overhead.
+// ==============================
+class SerialScope {
+public:
+    SerialScope();
+    ~SerialScope();
+
+    SerialScope(const SerialScope&) = delete;
+    SerialScope& operator=(const SerialScope&) = delete;
+
+private:
+    bool previous;      // state of enclosing scope, restored on exit
+};
+
+#endif // THREAD_POOL_H
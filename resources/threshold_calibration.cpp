@@ -0,0 +1,212 @@
+#include "threshold_calibration.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <random>
+#include <stdexcept>
+#include <vector>
+#include "column_stats.h"
+#include "xor_utils.h"
+
+namespace {
+
+    // Calls onColumn with the histogram of every sampled column (same columns for the same options)
+    void forEachSampledColumn(std::string_view sample, const CalibrationOptions& options, const std::function<void(const ByteHistogram&)>& onColumn) {
+        std::mt19937_64 rng(options.seed);
+        const size_t lengthRange = options.maxColumnLength - options.minColumnLength + 1;
+        for (size_t t = 0; t < options.trials; t++) {
+            size_t length = options.minColumnLength + rng() % lengthRange;
+            size_t stride = 1 + rng() % static_cast<size_t>(options.maxStride);
+            size_t position = rng() % sample.size();
+            ByteHistogram hist{};
+            for (size_t i = 0; i < length; i++) {
+                hist[static_cast<unsigned char>(sample[position])]++;
+                position = (position + stride) % sample.size();
+            }
+            onColumn(hist);
+        }
+    }
+
+    // Plaintext histogram decoded with key k is the column of ciphertext byte (true key ^ k),
+    // so key 0 plays the correct key and keys 1-255 the wrong ones
+    bool passes(const ByteHistogram& hist, int key, const ThresholdConfig& thresholds) {
+        return histogramPrintableRatio(hist, key) >= thresholds.printableCharTreshhold
+            && histogramFittingQuotient(hist, key) < thresholds.chi2threshold;
+    }
+}
+
+
+//=============================================
+// Calibrate candidate thresholds
+// Takes:
+//      samplePlaintext - plaintext representative of what will be decrypted
+//      options         - target false-reject rate, number and shape of sampled columns
+// Returns:
+//      Thresholds with their false-reject rate and candidate volume, and the
+//      same measures for the built-in thresholds
+// Throws:
+//      std::invalid_argument if the sample or options can't produce columns
+// Note:
+//      Half of the false-reject budget goes to the printable threshold (its
+//      quantile, rounded down to 0.01), the rest to the smallest Chi^2
+//      threshold that keeps total rejections of the correct key within budget.
+//=============================================
+
+CalibrationReport calibrateThresholds(std::string_view samplePlaintext, const CalibrationOptions& options) {
+    if (options.trials == 0 || options.minColumnLength == 0 || options.maxColumnLength < options.minColumnLength
+        || options.maxStride < 1 || options.falseRejectRate < 0 || options.falseRejectRate >= 1) {
+        throw std::invalid_argument("Invalid calibration options");
+    }
+    if (samplePlaintext.size() < options.maxColumnLength) {
+        throw std::invalid_argument("Calibration sample is shorter than a column");
+    }
+
+    // Scores of the correct key in every column
+    std::vector<double> printable;
+    std::vector<double> chi2;
+    printable.reserve(options.trials);
+    chi2.reserve(options.trials);
+    forEachSampledColumn(samplePlaintext, options, [&](const ByteHistogram& hist) {
+        printable.push_back(histogramPrintableRatio(hist, 0));
+        chi2.push_back(histogramFittingQuotient(hist, 0));
+        });
+
+    const size_t n = printable.size();
+    const size_t allowedRejects = static_cast<size_t>(options.falseRejectRate * n);
+
+    CalibrationReport report;
+    report.trials = n;
+    std::vector<double> sortedPrintable = printable;
+    std::sort(sortedPrintable.begin(), sortedPrintable.end());
+    report.thresholds.printableCharTreshhold = std::floor(sortedPrintable[allowedRejects / 2] * 100) / 100;
+
+    std::vector<double> passingChi2;
+    for (size_t i = 0; i < n; i++) {
+        if (printable[i] >= report.thresholds.printableCharTreshhold) passingChi2.push_back(chi2[i]);
+    }
+    std::sort(passingChi2.begin(), passingChi2.end());
+    const size_t rejectedByPrintable = n - passingChi2.size();
+    const size_t chi2Rejects = allowedRejects > rejectedByPrintable ? allowedRejects - rejectedByPrintable : 0;
+    report.thresholds.chi2threshold = chi2Rejects < passingChi2.size()
+        ? static_cast<int>(std::floor(passingChi2[passingChi2.size() - chi2Rejects - 1])) + 1 : 0;
+
+    // False rejects and wrong keys let through, calibrated vs built-in thresholds
+    const ThresholdConfig builtIn;
+    size_t rejected = 0, defaultRejected = 0;
+    uint64_t candidates = 0, defaultCandidates = 0;
+    forEachSampledColumn(samplePlaintext, options, [&](const ByteHistogram& hist) {
+        if (!passes(hist, 0, report.thresholds)) rejected++;
+        if (!passes(hist, 0, builtIn)) defaultRejected++;
+        for (int key = 1; key < 256; key++) {
+            if (passes(hist, key, report.thresholds)) candidates++;
+            if (passes(hist, key, builtIn)) defaultCandidates++;
+        }
+        });
+    report.falseRejectRate = static_cast<double>(rejected) / n;
+    report.candidatesPerColumn = static_cast<double>(candidates) / n;
+    report.defaultFalseRejectRate = static_cast<double>(defaultRejected) / n;
+    report.defaultCandidatesPerColumn = static_cast<double>(defaultCandidates) / n;
+    return report;
+}
+
+
+//=============================================
+// Save thresholds
+// Takes:
+//      filename   - config file to write
+//      thresholds - values to save
+// Throws:
+//      std::runtime_error if the file can't be written
+//=============================================
+
+void saveThresholdConfig(const std::string& filename, const ThresholdConfig& thresholds) {
+    std::ofstream file(filename);
+    if (!file.is_open()) {
+        throw std::runtime_error("Error: Could not open file " + filename);
+    }
+    file << "# Candidate filter thresholds (see threshold_calibration.h)\n";
+    file << "chi2threshold = " << thresholds.chi2threshold << "\n";
+    file << "printableCharTreshhold = " << thresholds.printableCharTreshhold << "\n";
+}
+
+
+//=============================================
+// Load thresholds
+// Takes:
+//      filename - config file written by saveThresholdConfig
+// Returns:
+//      Thresholds from the file, built-in values for names it doesn't set
+// Throws:
+//      std::runtime_error if the file can't be read or a line is malformed
+// Note:
+//      Unknown names are ignored, so newer files still load
+//=============================================
+
+ThresholdConfig loadThresholdConfig(const std::string& filename) {
+    std::ifstream file(filename);
+    if (!file.is_open()) {
+        throw std::runtime_error("Error: Could not open file " + filename);
+    }
+    auto trim = [](std::string s) {
+        s.erase(0, s.find_first_not_of(" \t\r"));
+        s.erase(s.find_last_not_of(" \t\r") + 1);
+        return s;
+    };
+
+    ThresholdConfig thresholds;
+    std::string line;
+    while (std::getline(file, line)) {
+        line = trim(line.substr(0, line.find('#')));
+        if (line.empty()) continue;
+        size_t equals = line.find('=');
+        if (equals == std::string::npos) {
+            throw std::runtime_error("Error: Malformed line in " + filename + ": " + line);
+        }
+        std::string name = trim(line.substr(0, equals));
+        std::string value = trim(line.substr(equals + 1));
+        try {
+            if (name == "chi2threshold") thresholds.chi2threshold = std::stoi(value);
+            else if (name == "printableCharTreshhold") thresholds.printableCharTreshhold = std::stod(value);
+        }
+        catch (const std::logic_error&) {
+            throw std::runtime_error("Error: Invalid value in " + filename + ": " + line);
+        }
+    }
+    return thresholds;
+}
+
+
+//=============================================
+// Default config file name
+// Returns:
+//      Value of XOR_THRESHOLDS_CONFIG if set, otherwise xor_thresholds.cfg
+//=============================================
+
+std::string defaultThresholdConfigPath() {
+    const char* path = std::getenv("XOR_THRESHOLDS_CONFIG");
+    return path && *path ? path : "xor_thresholds.cfg";
+}
+
+
+//=============================================
+// Thresholds in effect
+// Returns:
+//      Thresholds from the default config file (thread-safe lazy init),
+//      built-in values if the file doesn't exist
+// Throws:
+//      std::runtime_error if the file exists but is malformed, or if
+//      XOR_THRESHOLDS_CONFIG names a file that can't be opened
+//=============================================
+
+const ThresholdConfig& defaultThresholds() {
+    static const ThresholdConfig thresholds = [] {
+        const std::string path = defaultThresholdConfigPath();
+        const char* variable = std::getenv("XOR_THRESHOLDS_CONFIG");
+        const bool explicitPath = variable && *variable;
+        if (!explicitPath && !std::ifstream(path).is_open()) return ThresholdConfig{};
+        return loadThresholdConfig(path);
+    }();
+    return thresholds;
+}
@@ -0,0 +1,65 @@
+#ifndef THRESHOLD_CALIBRATION_H
+#define THRESHOLD_CALIBRATION_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// ==============================
+// THRESHOLD CALIBRATION - Candidate filter thresholds learned from sample plaintext
+//
+// A single-byte key candidate passes when its decoded column has at least
+// printableCharTreshhold letters/spaces and a Chi^2 fitting quotient below
+// chi2threshold. Calibration draws many columns from sample plaintext
+// (contiguous lines and strided columns of random lengths, wrapping around
+// the end of the sample), scores the correct key and all 255 wrong ones, and
+// picks the tightest thresholds that still reject the correct key no more
+// often than the target rate.
+//
+// Thresholds are saved as a small "name = value" config file. The library
+// loads it on first use from the file named by XOR_THRESHOLDS_CONFIG, or from
+// xor_thresholds.cfg in the working directory; without one the set1 values
+// (40, 0.7) are used. Only callers that ask for it read the config:
+// configuredBreakerParams() and the configured* threshold arguments of the
+// positional breaking functions (xor_utils.h). Plain BreakerParams keep set1 values.
+// ==============================
+
+struct ThresholdConfig {
+    int chi2threshold = 40;
+    double printableCharTreshhold = 0.7;
+};
+
+struct CalibrationOptions {
+    double falseRejectRate = 0.01;      // allowed share of correct keys rejected by the thresholds
+    size_t trials = 20000;              // sampled columns
+    size_t minColumnLength = 20;
+    size_t maxColumnLength = 200;
+    int maxStride = 40;                 // columns take every 1st..maxStride-th byte (1 == contiguous line)
+    uint64_t seed = 1;
+};
+
+// Outcome of calibration, with the default thresholds measured on the same columns for comparison
+struct CalibrationReport {
+    ThresholdConfig thresholds;
+    double falseRejectRate = 0;         // share of columns whose correct key fails the thresholds
+    double candidatesPerColumn = 0;     // average wrong keys passing the thresholds
+    double defaultFalseRejectRate = 0;
+    double defaultCandidatesPerColumn = 0;
+    size_t trials = 0;
+};
+
+// Learns thresholds from sample plaintext (throws if the sample is shorter than maxColumnLength)
+CalibrationReport calibrateThresholds(std::string_view samplePlaintext, const CalibrationOptions& options = {});
+
+// Writes / reads thresholds as "name = value" lines ('#' starts a comment)
+void saveThresholdConfig(const std::string& filename, const ThresholdConfig& thresholds);
+ThresholdConfig loadThresholdConfig(const std::string& filename);
+
+// Thresholds in effect: loaded from the config file on first use, built-in values if there is none
+const ThresholdConfig& defaultThresholds();
+
+// Name of the default config file (XOR_THRESHOLDS_CONFIG or xor_thresholds.cfg)
+std::string defaultThresholdConfigPath();
+
+#endif // THRESHOLD_CALIBRATION_H
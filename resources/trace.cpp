@@ -0,0 +1,95 @@
+#include "trace.h"
+#include "xor_utils.h"
+#include <atomic>
+#include <iostream>
+
+namespace {
+    std::atomic<TraceSink*> installedSink{ nullptr };
+}
+
+//=============================================
+// Trace event constructors
+//=============================================
+
+TraceEvent TraceEvent::keysizesRanked(const std::vector<int>& keysizes) {
+    TraceEvent event;
+    event.type = TraceEventType::KeysizesRanked;
+    event.keysizes = keysizes;
+    return event;
+}
+
+TraceEvent TraceEvent::keyByteFound(int keysize, int column, int keyByte) {
+    TraceEvent event;
+    event.type = TraceEventType::KeyByteFound;
+    event.keysize = keysize;
+    event.column = column;
+    event.keyByte = keyByte;
+    return event;
+}
+
+TraceEvent TraceEvent::columnFailed(int keysize, int column) {
+    TraceEvent event;
+    event.type = TraceEventType::ColumnFailed;
+    event.keysize = keysize;
+    event.column = column;
+    return event;
+}
+
+TraceEvent TraceEvent::keyFound(int keysize, const std::string& key) {
+    TraceEvent event;
+    event.type = TraceEventType::KeyFound;
+    event.keysize = keysize;
+    event.key = key;
+    return event;
+}
+
+TraceEvent TraceEvent::bestKeySelected(const std::string& key) {
+    TraceEvent event;
+    event.type = TraceEventType::BestKeySelected;
+    event.keysize = static_cast<int>(key.size());
+    event.key = key;
+    return event;
+}
+
+
+//=============================================
+// Install trace sink
+// Takes:
+//      sink - receiver of all events (nullptr to stop tracing)
+//=============================================
+
+void setTraceSink(TraceSink* sink) {
+    installedSink.store(sink, std::memory_order_release);
+}
+
+TraceSink* currentTraceSink() {
+    return installedSink.load(std::memory_order_acquire);
+}
+
+
+//=============================================
+// Console sink
+// Takes:
+//      event - trace event to print
+//=============================================
+
+void ConsoleTraceSink::onEvent(const TraceEvent& event) {
+    std::lock_guard<std::mutex> lock(outputMutex);
+    switch (event.type) {
+    case TraceEventType::KeysizesRanked:
+        printCandidateKeysizes(event.keysizes);
+        break;
+    case TraceEventType::KeyFound:
+        printKeyForKeysize(event.keysize, event.key);
+        break;
+    case TraceEventType::BestKeySelected:
+        std::cout << "\nBest key: " << event.key << "\n";
+        break;
+    case TraceEventType::KeyByteFound:
+        if (verbose) std::cout << "Keysize " << event.keysize << ", column " << event.column << ": key byte " << event.keyByte << "\n";
+        break;
+    case TraceEventType::ColumnFailed:
+        if (verbose) std::cout << "Keysize " << event.keysize << ", column " << event.column << ": no key byte passed thresholds\n";
+        break;
+    }
+}
@@ -0,0 +1,78 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <mutex>
+#include <string>
+#include <vector>
+
+// ==============================
+// TRACE - Structured events from the breaking pipeline
+//
+// The library never prints. Analysis steps report what they found as events
+// to the installed TraceSink; with no sink installed (default) an event is
+// not even constructed. Defining XOR_DISABLE_TRACE at compile time removes
+// all event code from the library.
+//
+// Events may arrive from several threads at once (columns and keysizes are
+// analyzed in parallel), sinks have to be thread-safe.
+// ==============================
+
+enum class TraceEventType {
+    KeysizesRanked,     // keysizes: candidate keysizes, best first
+    KeyByteFound,       // keysize, column, keyByte: column solved by frequency analysis
+    ColumnFailed,       // keysize, column: no key byte passed the thresholds
+    KeyFound,           // keysize, key: key extracted for a candidate keysize (empty if failed)
+    BestKeySelected     // keysize, key: key chosen by the breaker
+};
+
+struct TraceEvent {
+    TraceEventType type = TraceEventType::KeysizesRanked;
+    int keysize = 0;
+    int column = -1;
+    int keyByte = -1;
+    std::string key;
+    std::vector<int> keysizes;
+
+    static TraceEvent keysizesRanked(const std::vector<int>& keysizes);
+    static TraceEvent keyByteFound(int keysize, int column, int keyByte);
+    static TraceEvent columnFailed(int keysize, int column);
+    static TraceEvent keyFound(int keysize, const std::string& key);
+    static TraceEvent bestKeySelected(const std::string& key);
+};
+
+// Receiver of trace events
+class TraceSink {
+public:
+    virtual ~TraceSink() = default;
+    virtual void onEvent(const TraceEvent& event) = 0;
+};
+
+// Installs sink for all threads (nullptr == no sink), sink must outlive its installation
+void setTraceSink(TraceSink* sink);
+
+// Currently installed sink or nullptr
+TraceSink* currentTraceSink();
+
+// ==============================
+// Prints ranked keysizes, keys for every keysize and the best key in the
+// format of the command line tools. Column events are printed only if verbose.
+// ==============================
+class ConsoleTraceSink : public TraceSink {
+public:
+    explicit ConsoleTraceSink(bool verbose = false) : verbose(verbose) {}
+    void onEvent(const TraceEvent& event) override;
+
+private:
+    bool verbose;
+    std::mutex outputMutex;     // keeps lines from parallel workers apart
+};
+
+// Reports event to installed sink, event expression is evaluated only if there is one
+#ifdef XOR_DISABLE_TRACE
+#define XOR_TRACE(event) ((void)0)
+#else
+#define XOR_TRACE(event) \
+    do { if (TraceSink* traceSink_ = currentTraceSink()) traceSink_->onEvent(event); } while (0)
+#endif
+
+#endif // TRACE_H
@@ -0,0 +1,268 @@
+#include "word_validation.h"
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+#include <stdexcept>
+#include "common_utils.h"
+
+namespace {
+
+    // Most common English words, with the contractions and pronouns of everyday text
+    const char commonEnglishWords[] =
+        "a able about above across act actually add after again against age ago agree air all almost alone along "
+        "already also although always am among an and animal another answer any anyone anything appear apple are "
+        "area arm army around art as ask at away baby back bad bag ball bank bar base be bear beat beautiful became "
+        "because become bed been before began begin behind being believe bell below best better between big bird "
+        "bit black blood blue board boat body book born both bottom box boy bread break bring brother brought brown "
+        "build building built burn business busy but buy by call came can car card care carry case cat catch caught "
+        "cause cell center certain chair chance change character check child children choose church city class "
+        "clean clear close cold color come common company complete control cook cool corner cost could count "
+        "country course cover cross cry cut dance dark day dead deal dear death decide deep did die different "
+        "dinner direct do doctor does dog done door double down draw dream dress drink drive drop dry during each "
+        "ear early earth east easy eat edge effect egg eight either else end enemy enough enter even evening event "
+        "ever every everyone everything exactly example except eye face fact fair fall family far farm fast father "
+        "fear feel feet fell felt few field fight figure fill final finally find fine finger finish fire first fish "
+        "five floor fly follow food foot for force forest forget form forward found four free friend from front "
+        "full fun funny game garden gave general get girl give glass go god goes gold gone good got government "
+        "great green grey grew ground group grow guess gun had hair half hall hand happen happy hard has hat have "
+        "he head hear heard heart heat heavy held hello help her here herself high hill him himself his history hit "
+        "hold hole home hope horse hot hour house how however huge human hundred hurt husband i ice idea if "
+        "important in inside instead interest into iron is island it its itself job join just keep kept key kid "
+        "kill kind king kitchen knew know known lady land language large last late later laugh law lay lead learn "
+        "least leave led left leg less let letter lie life light like line list listen little live long look lost "
+        "lot love low machine made main make man many map mark market matter may maybe me mean meet member men "
+        "middle might mile milk mind minute miss moment money month moon more morning most mother mountain mouth "
+        "move much music must my myself name nation near need never new news next nice night nine no noise none "
+        "nor north not note nothing notice now number of off offer office often oh oil old on once one only open "
+        "or order other our out outside over own page paint paper parent part party pass past pay people perhaps "
+        "person pick picture piece place plan plant play please point police poor possible power present pretty "
+        "problem program pull push put question quick quiet quite rain ran rather reach read ready real really "
+        "reason red remember rest return rich ride right ring rise river road rock room round rule run said same "
+        "sat save saw say school science sea season seat second see seem seen sell send sense sent serve set seven "
+        "several shall shape she ship shoe short should shoulder shout show side sign simple since sing sister sit "
+        "six size skin sky sleep slow small smile snow so soft some someone something sometimes son song soon sort "
+        "sound south space speak special spend spring square stand star start state station stay step still stone "
+        "stood stop story street strong student study such summer sun sure surface system table take talk tall "
+        "teacher team tell ten than thank that the their them themselves then there these they thing think third "
+        "this those though thought thousand three through throw time tiny to today together told tomorrow too took "
+        "top touch toward town track train travel tree true try turn twenty two under understand until up upon us "
+        "use usual very voice wait walk wall want war warm was watch water way we wear weather week well went were "
+        "west what wheel when where whether which while white who whole why wide wife wild will win wind window "
+        "winter wish with within without woman women wonder wood word work world would write wrong yard yeah year "
+        "yell yellow yes yet you young your yourself "
+        "ain't aren't can't couldn't didn't doesn't don't hadn't hasn't haven't he'd he'll he's i'd i'll i'm i've "
+        "isn't it'd it'll it's let's she'd she'll she's shouldn't that's there's they'd they'll they're they've "
+        "wasn't we'd we'll we're we've weren't what's where's who's won't wouldn't you'd you'll you're you've";
+
+    char lower(char c) {
+        return (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c;
+    }
+
+    bool isLetter(char c) {
+        return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+    }
+}
+
+
+//=============================================
+// Build minimal perfect hash word set
+// Takes:
+//      words - words of the set (any case, duplicates allowed)
+// Throws:
+//      std::runtime_error if no displacement seed places some bucket
+//      (doesn't happen for sets of distinct words)
+// Note:
+//      About 4 words per bucket. Buckets are placed largest first: the
+//      seed of a bucket is the first one that sends all its words to free
+//      and distinct slots. Small buckets placed last fill the gaps.
+//=============================================
+
+PerfectHashWordSet::PerfectHashWordSet(const std::vector<std::string>& words) {
+    std::vector<std::string> unique;
+    unique.reserve(words.size());
+    for (const std::string& word : words) {
+        if (word.empty()) continue;
+        std::string lowered(word.size(), '\0');
+        std::transform(word.begin(), word.end(), lowered.begin(), lower);
+        unique.push_back(std::move(lowered));
+    }
+    std::sort(unique.begin(), unique.end());
+    unique.erase(std::unique(unique.begin(), unique.end()), unique.end());
+
+    const size_t n = unique.size();
+    wordCount = n;
+    seeds.assign(std::max<size_t>(1, n / 4), 0);
+    std::vector<std::vector<size_t>> buckets(seeds.size());
+    for (size_t i = 0; i < n; i++) {
+        buckets[wordHash(unique[i]) % seeds.size()].push_back(i);
+    }
+    std::vector<size_t> order(buckets.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return buckets[a].size() > buckets[b].size();
+        });
+
+    std::vector<size_t> wordInSlot(n, SIZE_MAX);
+    std::vector<size_t> slots;
+    for (size_t bucket : order) {
+        if (buckets[bucket].empty()) break;
+        bool placed = false;
+        for (uint32_t seed = 0; seed < (1u << 20) && !placed; seed++) {
+            seeds[bucket] = seed;
+            slots.clear();
+            placed = true;
+            for (size_t word : buckets[bucket]) {
+                size_t s = slot(wordHash(unique[word]));
+                if (wordInSlot[s] != SIZE_MAX || std::find(slots.begin(), slots.end(), s) != slots.end()) {
+                    placed = false;
+                    break;
+                }
+                slots.push_back(s);
+            }
+        }
+        if (!placed) {
+            throw std::runtime_error("Error: Could not build perfect hash of the word set");
+        }
+        for (size_t i = 0; i < slots.size(); i++) {
+            wordInSlot[slots[i]] = buckets[bucket][i];
+        }
+    }
+
+    offsets.reserve(n + 1);
+    offsets.push_back(0);
+    for (size_t s = 0; s < n; s++) {
+        const std::string& word = unique[wordInSlot[s]];
+        packed += word;
+        offsets.push_back(static_cast<uint32_t>(packed.size()));
+        longestWord = std::max(longestWord, word.size());
+    }
+}
+
+
+//=============================================
+// Word set lookup
+// Takes:
+//      word - lowercase word
+// Returns:
+//      True if word is in the set
+//=============================================
+
+bool PerfectHashWordSet::contains(std::string_view word) const {
+    if (word.empty() || word.size() > longestWord) return false;
+    const size_t s = slot(wordHash(word));
+    const size_t length = offsets[s + 1] - offsets[s];
+    return length == word.size() && std::memcmp(packed.data() + offsets[s], word.data(), length) == 0;
+}
+
+
+// FNV-1a over the word bytes, finished by the mixer
+uint64_t PerfectHashWordSet::wordHash(std::string_view word) {
+    uint64_t hash = 0xCBF29CE484222325ull;
+    for (char c : word) {
+        hash = (hash ^ static_cast<unsigned char>(c)) * 0x100000001B3ull;
+    }
+    return splitMix64(hash);
+}
+
+
+// Slot of a word: its bucket's seed displaces the hash
+size_t PerfectHashWordSet::slot(uint64_t hash) const {
+    const uint32_t seed = seeds[hash % seeds.size()];
+    return splitMix64(hash ^ (static_cast<uint64_t>(seed) << 32 | seed)) % wordCount;
+}
+
+
+//=============================================
+// Default dictionary
+// Returns:
+//      Perfect hash set of the embedded common English words
+//      (thread-safe lazy init)
+//=============================================
+
+const PerfectHashWordSet& defaultWordSet() {
+    static const PerfectHashWordSet dictionary = [] {
+        std::vector<std::string> words;
+        std::string_view list(commonEnglishWords);
+        while (!list.empty()) {
+            size_t end = std::min(list.find(' '), list.size());
+            words.emplace_back(list.substr(0, end));
+            list.remove_prefix(std::min(end + 1, list.size()));
+        }
+        return PerfectHashWordSet(words);
+    }();
+    return dictionary;
+}
+
+
+//=============================================
+// Count dictionary words
+// Takes:
+//      text       - candidate plaintext
+//      dictionary - word set to look words up in
+// Returns:
+//      Number of words in text and of those found in dictionary
+// Note:
+//      A word is a run of letters, an apostrophe between two letters is part
+//      of it ("don't"). Words are lowercased while they are read; a word
+//      longer than the longest dictionary word is counted as a miss without
+//      lookup.
+//=============================================
+
+WordHits countDictionaryWords(std::string_view text, const PerfectHashWordSet& dictionary) {
+    WordHits hits;
+    std::string word;
+    word.reserve(dictionary.maxWordLength() + 1);
+    bool tooLong = false;
+
+    auto finishWord = [&]() {
+        if (word.empty() && !tooLong) return;
+        hits.words++;
+        if (!tooLong && dictionary.contains(word)) hits.hits++;
+        word.clear();
+        tooLong = false;
+    };
+
+    for (size_t i = 0; i < text.size(); i++) {
+        const char c = text[i];
+        const bool apostrophe = c == '\'' && !word.empty() && i + 1 < text.size() && isLetter(text[i + 1]);
+        if (!isLetter(c) && !apostrophe) {
+            finishWord();
+            continue;
+        }
+        if (word.size() == dictionary.maxWordLength()) tooLong = true;
+        if (!tooLong) word.push_back(lower(c));
+    }
+    finishWord();
+    return hits;
+}
+
+
+//=============================================
+// Word-hit ratio
+// Takes:
+//      text       - candidate plaintext
+//      dictionary - word set to look words up in
+// Returns:
+//      Share of words of text found in dictionary (0 if text has no words)
+//=============================================
+
+double wordHitRatio(std::string_view text, const PerfectHashWordSet& dictionary) {
+    return countDictionaryWords(text, dictionary).ratio();
+}
+
+
+//=============================================
+// Word validation of candidate plaintext
+// Takes:
+//      text       - candidate plaintext (only its first wordValidationBytes bytes are read)
+//      dictionary - word set to look words up in
+// Returns:
+//      False if text has at least minValidationWords words and fewer than
+//      minWordHitRatio of them are in dictionary, true otherwise (too little
+//      text to judge is never rejected)
+//=============================================
+
+bool passesWordValidation(std::string_view text, const PerfectHashWordSet& dictionary) {
+    WordHits hits = countDictionaryWords(text.substr(0, wordValidationBytes), dictionary);
+    return hits.words < minValidationWords || hits.ratio() >= minWordHitRatio;
+}
@@ -0,0 +1,77 @@
+#ifndef WORD_VALIDATION_H
+#define WORD_VALIDATION_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// ==============================
+// WORD VALIDATION - Dictionary check of candidate plaintext
+//
+// Letter frequencies alone let through decryptions that have English-like
+// bytes but no English words. Candidate plaintext is split into words
+// (letter runs, apostrophes inside a word are kept, case is ignored) and each
+// word is looked up in a dictionary of common English words. The share of
+// words found, the word-hit ratio, is close to 0 for wrong keys.
+//
+// The dictionary is a minimal perfect hash (hash and displace): a word's
+// hash picks a bucket, the bucket's displacement seed maps it to one of n
+// slots and the slot holds the only word that can match. A lookup is two
+// hashes and one comparison. The words are packed back to back in slot
+// order, so the whole set takes a few KB.
+// ==============================
+
+class PerfectHashWordSet {
+public:
+    // Builds the set from words (lowercased, empty and duplicate words dropped)
+    explicit PerfectHashWordSet(const std::vector<std::string>& words);
+
+    // True if lowercase word is in the set
+    bool contains(std::string_view word) const;
+
+    // Number of words in the set
+    size_t size() const { return wordCount; }
+
+    // Length of the longest word, longer words are never in the set
+    size_t maxWordLength() const { return longestWord; }
+
+private:
+    static uint64_t wordHash(std::string_view word);
+    size_t slot(uint64_t hash) const;
+
+    std::string packed;                 // words back to back in slot order
+    std::vector<uint32_t> offsets;      // word in slot s is packed[offsets[s] .. offsets[s + 1])
+    std::vector<uint32_t> seeds;        // displacement seed of every bucket
+    size_t wordCount = 0;
+    size_t longestWord = 0;         // 0 for an empty set, so nothing is looked up
+};
+
+// Dictionary of common English words, built on first use
+const PerfectHashWordSet& defaultWordSet();
+
+// Words of text and how many of them the dictionary holds
+struct WordHits {
+    size_t words = 0;
+    size_t hits = 0;
+
+    double ratio() const { return words != 0 ? static_cast<double>(hits) / words : 0.0; }
+};
+
+// Splits text into words and looks every one up, O(n)
+WordHits countDictionaryWords(std::string_view text, const PerfectHashWordSet& dictionary = defaultWordSet());
+
+// Share of words of text found in the dictionary (0 if text has no words)
+double wordHitRatio(std::string_view text, const PerfectHashWordSet& dictionary = defaultWordSet());
+
+// Plaintext with at least minValidationWords words needs minWordHitRatio of them in the dictionary,
+// only the first wordValidationBytes bytes are checked
+constexpr size_t minValidationWords = 4;
+constexpr double minWordHitRatio = 0.2;
+constexpr size_t wordValidationBytes = 4096;
+
+// Second-stage filter after Chi^2: false if text has enough words and too few are English
+bool passesWordValidation(std::string_view text, const PerfectHashWordSet& dictionary = defaultWordSet());
+
+#endif // WORD_VALIDATION_H
@@ -1,11 +1,148 @@
 #include "xor_utils.h"
 #include "converters.h"
+#include "allocation_tracker.h"
+#include "instrumentation.h"
+#include "column_sampling.h"
+#include "key_refinement.h"
+#include "keysize_kernels.h"
+#include "pair_scoring.h"
+#include "perf_counters.h"
+#include "thread_pool.h"
+#include "trace.h"
+#include "word_validation.h"
 #include <cctype>
 #include <algorithm>
 #include <string>
 #include <vector>
 #include <iostream>
 #include <bitset>
+#include <limits>
+#include <random>
+#include <stdexcept>
+
+namespace {
+
+    // Params of the positional breaking functions, configured* thresholds are read from the threshold config
+    BreakerParams positionalParams(int chi2threshold, int noOfKeysizes, double printableCharTreshhold) {
+        BreakerParams params;
+        params.chi2threshold = chi2threshold == configuredChi2threshold
+            ? defaultThresholds().chi2threshold : chi2threshold;
+        params.printableCharTreshhold = printableCharTreshhold == configuredPrintableCharTreshhold
+            ? defaultThresholds().printableCharTreshhold : printableCharTreshhold;
+        params.noOfKeysizes = noOfKeysizes;
+        return params;
+    }
+
+    // Chi^2 of a column decoded with every key byte, max() for bytes whose
+    // plaintext fails the printable characters threshold
+    std::array<double, 256> columnKeyChi2(const ByteHistogram& hist, double printableCharTreshhold, uint64_t& pruned) {
+        std::array<double, 256> chi2;
+        pruned = 0;
+        for (int k = 0; k < 256; k++) {
+            if (histogramPrintableRatio(hist, k) < printableCharTreshhold) {
+                chi2[k] = std::numeric_limits<double>::max();
+                pruned++;
+                continue;
+            }
+            chi2[k] = histogramFittingQuotient(hist, k);
+        }
+        return chi2;
+    }
+
+    // Byte with the lowest Chi^2 (-1 if every byte is pruned). Chi^2 can't tell it from
+    // key ^ 0x20, which decodes the same letters in the other case: of the two, the
+    // byte that decodes more lowercase than uppercase letters is taken.
+    int bestColumnKey(const ByteHistogram& hist, const std::array<double, 256>& chi2) {
+        const int best = static_cast<int>(std::min_element(chi2.begin(), chi2.end()) - chi2.begin());
+        if (chi2[best] == std::numeric_limits<double>::max()) return -1;
+        const int twin = best ^ 0x20;
+        if (chi2[twin] == std::numeric_limits<double>::max()) return best;
+        uint64_t lowercase = 0, uppercase = 0;
+        for (int letter = 'a'; letter <= 'z'; letter++) {
+            lowercase += hist[static_cast<unsigned char>(letter ^ best)];
+            uppercase += hist[static_cast<unsigned char>((letter & ~0x20) ^ best)];
+        }
+        return uppercase > lowercase ? twin : best;
+    }
+
+    // Fallback for a column whose best byte scores chi2threshold or more, where letter frequencies
+    // alone don't settle it: of its chi2FallbackCandidates lowest-Chi^2 bytes, the one whose
+    // decoded column is most likely under the byte unigram model (which knows punctuation and digits)
+    int unigramColumnKey(const ByteHistogram& hist, const std::array<double, 256>& chi2) {
+        std::array<int, 256> order;
+        for (int k = 0; k < 256; k++) order[k] = k;
+        std::partial_sort(order.begin(), order.begin() + chi2FallbackCandidates, order.end(),
+            [&](int a, int b) { return chi2[a] < chi2[b]; });
+        const ByteLanguageModel& model = defaultLanguageModel();
+        int best = order[0];
+        double bestLikelihood = columnKeyLogLikelihood(hist, best, model);
+        for (int c = 1; c < chi2FallbackCandidates && chi2[order[c]] != std::numeric_limits<double>::max(); c++) {
+            const double likelihood = columnKeyLogLikelihood(hist, order[c], model);
+            if (likelihood > bestLikelihood) {
+                best = order[c];
+                bestLikelihood = likelihood;
+            }
+        }
+        return best;
+    }
+
+    // Relative Chi^2 gap between chosen key byte and the best other byte of the column.
+    // key ^ 0x20 is left out: it only flips the case of letters, which Chi^2 can't tell apart.
+    double columnConfidence(const std::array<double, 256>& chi2, double chosen, int key) {
+        double runnerUp = std::numeric_limits<double>::max();
+        for (int k = 0; k < 256; k++) {
+            if (k != key && k != (key ^ 0x20)) runnerUp = std::min(runnerUp, chi2[k]);
+        }
+        if (runnerUp == std::numeric_limits<double>::max()) return 1.0;    // no other byte passes
+        return runnerUp > chosen ? (runnerUp - chosen) / runnerUp : 0.0;
+    }
+
+    // Key of every column by Chi^2 (empty if a column has no byte passing the printable
+    // characters threshold) and the smallest column confidence, from the same scores.
+    // A column whose best byte scores chi2threshold or more takes its byte from unigramColumnKey,
+    // with confidence 0 if that's not the byte Chi^2 picked.
+    std::string keyFromColumnHistograms(const std::vector<ByteHistogram>& columnHistograms, int chi2threshold, double printableCharTreshhold, double& confidence) {
+        XOR_ALLOCATION_SCOPE(Stage::ColumnScoring);
+        std::vector<int> singleXORKeys(columnHistograms.size(), -1); // keys for each group of bytes, -1 if not found
+        std::vector<double> confidences(columnHistograms.size(), 0.0);
+
+        defaultThreadPool().parallelFor(columnHistograms.size(), [&](size_t i) {
+            XOR_STAGE_TIMER(Stage::ColumnScoring);
+            const uint64_t columnLength = histogramTotal(columnHistograms[i]);
+            if (columnLength != 0) {
+                XOR_PROFILE_KERNEL(Kernel::KeyScoring, columnLength);
+                uint64_t pruned = 0;
+                const std::array<double, 256> chi2 = columnKeyChi2(columnHistograms[i], printableCharTreshhold, pruned);
+                const int best = bestColumnKey(columnHistograms[i], chi2);
+                if (best >= 0) {
+                    singleXORKeys[i] = chi2[best] < chi2threshold ? best : unigramColumnKey(columnHistograms[i], chi2);
+                    confidences[i] = singleXORKeys[i] == best ? columnConfidence(chi2, chi2[best], best) : 0.0;
+                }
+                XOR_STAGE_COUNT(Stage::ColumnScoring, StageCounter::KeysScored, 256 - pruned);
+                XOR_STAGE_COUNT(Stage::ColumnScoring, StageCounter::CandidatesPruned, pruned);
+            }
+            if (singleXORKeys[i] >= 0) {
+                XOR_TRACE(TraceEvent::keyByteFound(static_cast<int>(columnHistograms.size()), static_cast<int>(i), singleXORKeys[i]));
+            }
+            else {
+                XOR_TRACE(TraceEvent::columnFailed(static_cast<int>(columnHistograms.size()), static_cast<int>(i)));
+            }
+            });
+
+        // A column without key means no byte passes the thresholds. Don't return incomplete key.
+        std::string fullKeyStr; // store full key for current keysize
+        confidence = 0.0;
+        if (std::find(singleXORKeys.begin(), singleXORKeys.end(), -1) != singleXORKeys.end())
+            return fullKeyStr;
+
+        fullKeyStr.reserve(singleXORKeys.size());
+        for (int k : singleXORKeys) {
+            fullKeyStr += static_cast<char>(k);
+        }
+        confidence = *std::min_element(confidences.begin(), confidences.end());
+        return fullKeyStr;
+    }
+}
 
 //=============================================
 // Fixed XOR of two equal-length hex strings
@@ -207,6 +344,130 @@ std::vector<double> XOR_iterateKeys_chi2(std::string_view inputStr, int chi2thre
 }
 
 
+//=============================================
+// Iterate through all possible single-byte XOR keys using column histogram
+// Takes:
+//      hist - byte histogram of XOR encrypted column
+//      chi2threshold - Chi-square threshold for candidate acceptance
+//      printableCharThreshold - minimum ratio of printable chars required
+//      onlyBestFit - if true, return only the key with lowest Chi^2 (vector with single key)
+// Returns:
+//      Vector of candidate keys passing frequency analysis
+// Note:
+//      Decoding a column with key k turns byte b into b ^ k, so every statistic
+//      of the decoded column can be read from the encrypted column's histogram.
+//      Each key costs O(256) no matter how long the column is.
+//=============================================
+
+std::vector<int> XOR_iterateKeys_hist(const ByteHistogram& hist, int chi2threshold, double printableCharTreshhold, bool onlyBestFit)
+{
+    std::vector<int> candidateKeys;
+    const uint64_t columnLength = histogramTotal(hist);
+    if (columnLength == 0) return candidateKeys;
+    XOR_PROFILE_KERNEL(Kernel::KeyScoring, columnLength);
+
+    uint64_t pruned = 0;
+    const std::array<double, 256> chi2 = columnKeyChi2(hist, printableCharTreshhold, pruned);
+    if (onlyBestFit) {
+        const int best = bestColumnKey(hist, chi2);
+        if (best >= 0) candidateKeys.push_back(best);
+    }
+    else {
+        for (int i = 0; i < 256; i++) {
+            if (chi2[i] < chi2threshold) candidateKeys.push_back(i);
+        }
+    }
+    XOR_STAGE_COUNT(Stage::ColumnScoring, StageCounter::KeysScored, 256 - pruned);
+    XOR_STAGE_COUNT(Stage::ColumnScoring, StageCounter::CandidatesPruned, pruned);
+    return candidateKeys;
+}
+
+
+//=============================================
+// Compute Chi-square fitting quotient of a column decoded with given key
+// Takes:
+//      hist - byte histogram of XOR encrypted column
+//      key  - single-byte key (0-255)
+// Returns:
+//      Same value as singleKeyFittingQuotient on the decoded column
+//=============================================
+
+double histogramFittingQuotient(const ByteHistogram& hist, int key) {
+    // Letter frequencies of charFreqTable as probabilities, "ABC... XYZ[space]"
+    static const std::array<double, 27> letterProbabilities = [] {
+        std::array<double, 27> probabilities{};
+        for (int i = 0; i < 27; i++) {
+            probabilities[i] = charFreqTable(i < 26 ? static_cast<char>('A' + i) : ' ') / 100.0;
+        }
+        return probabilities;
+    }();
+    const double strLen = static_cast<double>(histogramTotal(hist));
+    double fittingQuotient = 0;
+    for (int i = 0; i < 27; i++) {
+        // countCharOccurance is case-insensitive, so lowercase letters count too
+        const int letter = i < 26 ? 'A' + i : ' ';
+        uint64_t realOcc = hist[static_cast<unsigned char>(letter ^ key)];
+        if (letter != ' ')
+            realOcc += hist[static_cast<unsigned char>((letter | 0x20) ^ key)];
+
+        // Same as singleCharFittingQuotient, counts are kept 64-bit for large columns
+        double expected = letterProbabilities[i] * strLen;
+        if (expected < 1e-6) continue;
+        double occured = static_cast<double>(realOcc);
+        fittingQuotient += ((occured - expected) * (occured - expected)) / expected;
+    }
+    return fittingQuotient;
+}
+
+
+//=============================================
+// Ratio of letters and spaces in a column decoded with given key
+// Takes:
+//      hist - byte histogram of XOR encrypted column
+//      key  - single-byte key (0-255)
+// Returns:
+//      Fraction (0-1) of decoded bytes that are letters or spaces
+//=============================================
+
+double histogramPrintableRatio(const ByteHistogram& hist, int key) {
+    static const std::string lettersAndSpace = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz ";
+    uint64_t total = histogramTotal(hist);
+    if (total == 0) return 0.0;
+    uint64_t letterOrSpaceCount = 0;
+    for (char c : lettersAndSpace) {
+        letterOrSpaceCount += hist[static_cast<unsigned char>(c ^ key)];
+    }
+    return static_cast<double>(letterOrSpaceCount) / total;
+}
+
+
+//=============================================
+// Confidence of a key found by column analysis
+// Takes:
+//      columnHistograms      - byte histograms of all key columns
+//      key                   - key to rate, one byte per column
+//      printableCharTreshhold - bytes whose plaintext fails it are no competitors
+// Returns:
+//      Minimum over columns of (runnerUpChi2 - chosenChi2) / runnerUpChi2,
+//      clipped to 0-1 (0 when some other byte fits a column at least as well)
+// Note:
+//      The runner-up of key byte k is never k ^ 0x20, which decodes the same
+//      letters in the other case and has nearly the same Chi^2
+//=============================================
+
+double keyConfidence(const std::vector<ByteHistogram>& columnHistograms, std::string_view key, double printableCharTreshhold) {
+    if (key.empty() || key.size() != columnHistograms.size()) return 0.0;
+    double confidence = 1.0;
+    for (size_t c = 0; c < key.size(); c++) {
+        const int chosenKey = static_cast<unsigned char>(key[c]);
+        uint64_t pruned = 0;
+        const std::array<double, 256> chi2 = columnKeyChi2(columnHistograms[c], printableCharTreshhold, pruned);
+        confidence = std::min(confidence, columnConfidence(chi2, histogramFittingQuotient(columnHistograms[c], chosenKey), chosenKey));
+    }
+    return confidence;
+}
+
+
 //=============================================
 // Compute Chi-square fitting quotient for string (for single key)
 // Measures how closely letter frequency in inputStr matches English
@@ -296,16 +557,18 @@ double charFreqTable(char c) {
 //      XOR-encrypted string
 // Note:
 //      Each character of the input is XOR-ed with the corresponding
-//      character from the key (repeated as needed)
+//      character from the key (repeated as needed).
+//      Keys up to maxFixedKeysize bytes use a kernel specialized for the key length
 //=============================================
 
 std::string XOR_repeatingKeyEncrypt(std::string_view inputStr, std::string_view key) {
+    XOR_STAGE_TIMER(Stage::Decrypt);
+    XOR_ALLOCATION_SCOPE(Stage::Decrypt);
+    XOR_STAGE_COUNT(Stage::Decrypt, StageCounter::Bytes, inputStr.size());
     std::string encryptedStr = std::string{ inputStr };
-    size_t keyLen = key.length();
-    size_t inputLen = inputStr.length();
-    for (size_t i = 0; i < inputLen; i++) {
-        encryptedStr[i] = encryptedStr[i] ^ key[i % keyLen];
-    }
+    if (key.empty()) return encryptedStr;   // nothing to XOR with
+    unsigned char* bytes = reinterpret_cast<unsigned char*>(encryptedStr.data());
+    repeatingKeyXorKernel(bytes, bytes, encryptedStr.size(), reinterpret_cast<const unsigned char*>(key.data()), static_cast<int>(key.size()));
     return encryptedStr;
 }
 
@@ -316,33 +579,295 @@ std::string XOR_repeatingKeyEncrypt(std::string_view inputStr, std::string_view
 // Takes:
 //      asciiData             - encrypted ASCII data
 //      chi2threshold         - threshold for Chi^2 filter on key candidates
+//                              (configuredChi2threshold: from threshold config)
 //      noOfKeysizes          - number of candidate keysizes to try
 //      printableCharTreshhold - minimum fraction of printable characters required
+//                              (configuredPrintableCharTreshhold: from threshold config)
 // Returns:
 //      Decrypted text string
+// Throws:
+//      std::runtime_error if a threshold is taken from a malformed config file
 // Note:
-//      Detects likely keysizes, extracts possible keys for them,
-//      picks the best key based on Chi^2 score and decrypts the input.
+//      See XOR_findRepeatingKey, the key found is reported as BestKeySelected trace event
 //=============================================
 
 std::string XOR_breakRepeatingKey(const std::string& asciiData, int chi2threshold, int noOfKeysizes, double printableCharTreshhold)
 {
-    // Get candidate keysizes
-    std::vector<int> candidateKeysizes = getCandidateKeysizes(asciiData, noOfKeysizes);
+    BreakResult result = XOR_findRepeatingKey(asciiData, chi2threshold, noOfKeysizes, printableCharTreshhold);
+    XOR_TRACE(TraceEvent::bestKeySelected(result.key));
+
+    std::string decryptedText = XOR_repeatingKeyEncrypt(asciiData, result.key);
+    return decryptedText;
+}
+
+
+//=============================================
+// Break repeating-key XOR encryption with known plaintext
+// Takes:
+//      asciiData             - encrypted ASCII data
+//      crib                  - known plaintext
+//      cribOffset            - position of crib in the plaintext, unknownCribOffset if unknown
+//      chi2threshold         - threshold for Chi^2 filter on key candidates
+//                              (configuredChi2threshold: from threshold config)
+//      noOfKeysizes          - number of candidate keysizes to try
+//      printableCharTreshhold - minimum fraction of printable characters required
+//                              (configuredPrintableCharTreshhold: from threshold config)
+// Returns:
+//      Decrypted text string
+// Throws:
+//      std::runtime_error if a threshold is taken from a malformed config file
+// Note:
+//      See XOR_findKeyFromCrib, falls back to XOR_findRepeatingKey statistics
+//      if the crib is too short or gives no key
+//=============================================
+
+std::string XOR_breakRepeatingKey(const std::string& asciiData, std::string_view crib, size_t cribOffset, int chi2threshold, int noOfKeysizes, double printableCharTreshhold)
+{
+    BreakerParams params = positionalParams(chi2threshold, noOfKeysizes, printableCharTreshhold);
+    params.crib = std::string(crib);
+    params.cribOffset = cribOffset;
+    BreakResult result = XOR_findRepeatingKey(asciiData, params);
+    XOR_TRACE(TraceEvent::bestKeySelected(result.key));
+
+    return XOR_repeatingKeyEncrypt(asciiData, result.key);
+}
+
+
+//=============================================
+// Find repeating XOR key
+// Takes:
+//      asciiData             - encrypted ASCII data
+//      chi2threshold         - threshold for Chi^2 filter on key candidates
+//                              (configuredChi2threshold: from threshold config)
+//      noOfKeysizes          - number of candidate keysizes to try
+//      printableCharTreshhold - minimum fraction of printable characters required
+//                              (configuredPrintableCharTreshhold: from threshold config)
+// Returns:
+//      Best key, its keysize and confidence (empty key if none passes)
+// Throws:
+//      std::runtime_error if a threshold is taken from a malformed config file
+// Note:
+//      Runs XOR_findRepeatingKey with default keysize search limits and refinement sample
+//=============================================
+
+BreakResult XOR_findRepeatingKey(const std::string& asciiData, int chi2threshold, int noOfKeysizes, double printableCharTreshhold)
+{
+    return XOR_findRepeatingKey(asciiData, positionalParams(chi2threshold, noOfKeysizes, printableCharTreshhold));
+}
+
+
+//=============================================
+// Breaker params from threshold config
+// Returns:
+//      Default BreakerParams with chi2threshold and printableCharTreshhold
+//      of defaultThresholds()
+// Throws:
+//      std::runtime_error if the config file exists but is malformed, or if
+//      XOR_THRESHOLDS_CONFIG names a file that can't be opened
+//=============================================
+
+BreakerParams configuredBreakerParams() {
+    BreakerParams params;
+    params.chi2threshold = defaultThresholds().chi2threshold;
+    params.printableCharTreshhold = defaultThresholds().printableCharTreshhold;
+    return params;
+}
+
+
+//=============================================
+// Find repeating XOR key
+// Takes:
+//      asciiData - encrypted ASCII data
+//      params    - thresholds, number of candidate keysizes, keysize search limits,
+//                  size of the refinement sample and optional known plaintext
+// Returns:
+//      Best key, its keysize and confidence (empty key if none passes)
+// Note:
+//      A key derived from params.crib (XOR_findKeyFromCrib) is returned right away.
+//      Detects likely keysizes by adaptive index of coincidence search (keysizes too large for it
+//      on short data by bigram fit, see pair_scoring.h), extracts possible keys for them,
+//      picks the key whose plaintext has the best Chi^2 score and refines it by hill
+//      climbing if its confidence is low. A column whose best byte scores params.chi2threshold
+//      or more takes the byte the unigram model prefers, and if that's another byte than
+//      Chi^2 picked, the key counts as low-confidence. With params.wordValidation keys whose
+//      plaintext isn't made of English words are dropped before key selection.
+//      Confidence is the key posterior under the unigram model, scaled down while the
+//      keysize margin is below confidentKeysizeMargin (0 if the key doesn't belong to
+//      the top-ranked keysize).
+//      Ranked keysizes and the key of every keysize are reported as trace events.
+//=============================================
+
+BreakResult XOR_findRepeatingKey(const std::string& asciiData, const BreakerParams& params)
+{
+    const double printableCharTreshhold = params.printableCharTreshhold;
+
+    // Known plaintext gives the key without any statistics
+    if (!params.crib.empty()) {
+        BreakResult cribResult = XOR_findKeyFromCrib(asciiData, params);
+        if (cribResult.keysize != 0) return cribResult;
+    }
+
+    // Get candidate keysizes (usually decided from a small sample of the data)
+    KeysizeSearchResult keysizeSearch;
+    std::vector<int> candidateKeysizes;
+    {
+        XOR_ALLOCATION_SCOPE(Stage::KeysizeDetection);
+        keysizeSearch = findKeysizesAdaptive(asciiData, params.noOfKeysizes, params.keysizeSearch);
+        candidateKeysizes = keysizeSearch.keysizes;
+
+        // Short ciphertext leaves large keysizes too few bytes per column for index of coincidence,
+        // those are ranked on the same sample by how well the best key pairs of adjacent columns fit
+        // bigram statistics. Keys of long keysizes overfit short columns and would win key selection,
+        // so one is taken only if it fits better than every candidate already taken (by more than
+        // bigramMultipleTolerance if it is a multiple of it: multiples of the right keysize fit as well).
+        const std::string_view keysizeSample = std::string_view(asciiData).substr(0, params.keysizeSearch.maxSampleSize);
+        const int coincidenceMaxKeysize = std::max(params.keysizeSearch.minKeysize - 1,
+            static_cast<int>(std::min<size_t>(params.keysizeSearch.maxKeysize, keysizeSample.size() / minCoincidenceColumnLength)));
+        if (coincidenceMaxKeysize < params.keysizeSearch.maxKeysize) {
+            const ByteLanguageModel& model = defaultLanguageModel();
+            std::vector<double> candidateFits;
+            for (int keysize : candidateKeysizes) {
+                candidateFits.push_back(keysizeBigramFit(keysizeSample, keysize, model));
+            }
+            for (int keysize : rankKeysizesByBigrams(keysizeSample, coincidenceMaxKeysize + 1, params.keysizeSearch.maxKeysize, params.noOfKeysizes, model)) {
+                const double fit = keysizeBigramFit(keysizeSample, keysize, model);
+                bool fitsBest = true;
+                for (size_t i = 0; i < candidateKeysizes.size(); i++) {
+                    const double required = candidateFits[i] + (keysize % candidateKeysizes[i] == 0 ? bigramMultipleTolerance : 0.0);
+                    if (fit <= required) fitsBest = false;
+                }
+                if (fitsBest) {
+                    candidateKeysizes.push_back(keysize);
+                    candidateFits.push_back(fit);
+                }
+            }
+        }
+        XOR_TRACE(TraceEvent::keysizesRanked(candidateKeysizes));
+    }
+
+    // Column histograms of candidate keysizes. Huge inputs are read only as far as
+    // a stratified sample needs to make every key byte stand out.
+    std::vector<std::vector<ByteHistogram>> candidateColumns;
+    {
+        XOR_STAGE_TIMER(Stage::Transposition);
+        XOR_ALLOCATION_SCOPE(Stage::Transposition);
+        candidateColumns.resize(candidateKeysizes.size());
+        if (asciiData.size() > sampledStatisticsThreshold) {
+            defaultThreadPool().parallelFor(candidateKeysizes.size(), [&](size_t i) {
+                SampledColumnHistograms sample = sampleColumnHistograms(asciiData, candidateKeysizes[i], defaultLanguageModel());
+                XOR_STAGE_COUNT(Stage::Transposition, StageCounter::Bytes, sample.sampledBytes);
+                candidateColumns[i] = std::move(sample.columns);
+                });
+        }
+        else {
+            KeysizeHistograms histograms(candidateKeysizes);
+            histograms.append(asciiData);
+            XOR_STAGE_COUNT(Stage::Transposition, StageCounter::Bytes, asciiData.size());
+            for (size_t i = 0; i < candidateKeysizes.size(); i++) {
+                candidateColumns[i] = histograms.columns(candidateKeysizes[i]);
+            }
+        }
+    }
+
+    // Get key for each group of bytes encrypted with the same key byte
+    // Candidate keysizes are independent, so they are processed concurrently
     std::vector<std::string> finalKeys;
+    std::vector<double> finalConfidences;
+    {
+        XOR_ALLOCATION_SCOPE(Stage::ColumnScoring);
+        finalKeys.resize(candidateKeysizes.size());
+        finalConfidences.resize(candidateKeysizes.size(), 0.0);
+        defaultThreadPool().parallelFor(candidateKeysizes.size(), [&](size_t i) {
+            if (asciiData.size() / candidateKeysizes[i] >= minFrequencyAnalysisColumnLength)
+                finalKeys[i] = keyFromColumnHistograms(candidateColumns[i], params.chi2threshold, printableCharTreshhold, finalConfidences[i]);
+            });
+    }
 
-    // Transpose the blocks in encoded text and get key for each group of blocks
-    // Try for each candidate keysize
-    for (int keysize : candidateKeysizes) {
-        finalKeys.push_back(getFullKeyFromGroupedBlocks(asciiData, keysize, chi2threshold, noOfKeysizes, printableCharTreshhold));
+    // Columns too short for frequency analysis alone are solved by beam search over top candidates of every column
+    const std::string_view refinementData = std::string_view(asciiData).substr(0, params.refinementBytes);
+    {
+        XOR_ALLOCATION_SCOPE(Stage::KeyRefinement);
+        std::vector<size_t> unsolved;
+        for (size_t i = 0; i < finalKeys.size(); i++) {
+            if (finalKeys[i].empty()) unsolved.push_back(i);
+        }
+        defaultThreadPool().parallelFor(unsolved.size(), [&](size_t u) {
+            const size_t i = unsolved[u];
+            finalKeys[i] = refineKeyBeamSearch(refinementData, candidateKeysizes[i], defaultBeamCandidates, defaultBeamWidth);
+            finalConfidences[i] = keyConfidence(candidateColumns[i], finalKeys[i], printableCharTreshhold);
+            });
     }
 
-    std::string bestKey = getBestKey(finalKeys, chi2threshold, printableCharTreshhold);
-    std::cout << "\nBest key: " << bestKey << "\n";
+    std::string bestKey;
+    {
+        XOR_ALLOCATION_SCOPE(Stage::KeySelection);
+        for (size_t i = 0; i < candidateKeysizes.size(); i++) {
+            XOR_TRACE(TraceEvent::keyFound(candidateKeysizes[i], finalKeys[i]));
+        }
+        if (params.wordValidation) finalKeys = filterKeysByWordValidation(asciiData, finalKeys);
+        bestKey = getBestKey(candidateColumns, finalKeys, printableCharTreshhold);
+    }
 
-    // Final decoded text is written to output.txt
-    std::string decryptedText = XOR_repeatingKeyEncrypt(asciiData, bestKey);
-    return decryptedText;
+    // Low-confidence key is refined with quadgram hill climbing. Only the selected key is refined,
+    // refining keys of wrong keysizes would only make them harder to tell from the right one.
+    // Its confidence comes from the same Chi^2 scores the key was picked by.
+    auto best = std::find(finalKeys.begin(), finalKeys.end(), bestKey);
+    if (!bestKey.empty() && finalConfidences[best - finalKeys.begin()] < lowKeyConfidence)
+        bestKey = refineKeyHillClimb(refinementData, bestKey, defaultHillClimbCandidates, defaultHillClimbIterations);
+
+    BreakResult result;
+    if (bestKey.empty()) return result;
+    XOR_ALLOCATION_SCOPE(Stage::KeySelection);
+    result.key = bestKey;
+    result.keysize = static_cast<int>(bestKey.size());
+    const double keysizeCertainty = result.keysize == candidateKeysizes.front()
+        ? std::min(1.0, keysizeSearch.margin / confidentKeysizeMargin) : 0.0;
+    result.confidence = keyPosterior(candidateColumns[best - finalKeys.begin()], bestKey, defaultLanguageModel()) * keysizeCertainty;
+    return result;
+}
+
+
+//=============================================
+// Find repeating XOR key from known plaintext
+// Takes:
+//      asciiData - encrypted ASCII data
+//      params    - params.crib and params.cribOffset, keysize search range
+//                  and printable characters threshold
+// Returns:
+//      Key of the smallest keysize under which the crib's keystream repeats,
+//      confidence 1 (keysize 0 and empty key if no keysize fits)
+// Note:
+//      Keysizes up to crib length - minCribCheckBytes are tested, each in one
+//      pass over the data (see known_plaintext.h). At a given offset the crib
+//      itself proves the key. At an unknown offset the crib may repeat by
+//      chance, so the keys of all its offsets go through getBestKey (printable
+//      ratio and Chi^2, plus word validation if params.wordValidation) and the
+//      keysize is skipped if none passes.
+//=============================================
+
+BreakResult XOR_findKeyFromCrib(const std::string& asciiData, const BreakerParams& params)
+{
+    BreakResult result;
+    if (params.crib.size() <= minCribCheckBytes) return result;
+    const int maxKeysize = static_cast<int>(std::min<size_t>(params.keysizeSearch.maxKeysize, params.crib.size() - minCribCheckBytes));
+
+    XOR_ALLOCATION_SCOPE(Stage::KeysizeDetection);
+    for (int keysize = std::max(params.keysizeSearch.minKeysize, 1); keysize <= maxKeysize; keysize++) {
+        std::vector<std::string> keys = cribKeys(asciiData, params.crib, params.cribOffset, keysize);
+        if (keys.empty()) continue;
+        if (params.cribOffset == unknownCribOffset && params.wordValidation) keys = filterKeysByWordValidation(asciiData, keys);
+        std::string key = params.cribOffset != unknownCribOffset
+            ? keys.front() : getBestKey(asciiData, keys, params.printableCharTreshhold);
+        if (key.empty()) continue;
+
+        XOR_TRACE(TraceEvent::keysizesRanked({ keysize }));
+        XOR_TRACE(TraceEvent::keyFound(keysize, key));
+        result.keysize = keysize;
+        result.key = key;
+        result.confidence = 1.0;
+        return result;
+    }
+    return result;
 }
 
 
@@ -359,6 +884,7 @@ std::string XOR_breakRepeatingKey(const std::string& asciiData, int chi2threshol
 
 int getHammingDistance(std::string_view inputStr1, std::string_view inputStr2) {
     size_t len = std::min(inputStr1.size(), inputStr2.size());
+    XOR_PROFILE_KERNEL(Kernel::Hamming, len);
     int distance = 0;
     for (size_t i = 0; i < len; i++) {
         distance += std::bitset<8>(inputStr1[i] ^ inputStr2[i]).count();
@@ -435,25 +961,62 @@ std::vector<std::string> transposeVector(const std::vector<std::string>& blocks,
 
 
 //=============================================
-// Pick the best key from candidates based on Chi^2 score
+// Pick the best key from candidates based on Chi^2 score of their plaintext
 // Takes:
-//      finalKeys             - vector of extracted keys
-//      chi2threshold         - Chi^2 threshold for key scoring
+//      histograms            - column histograms of all candidate keysizes
+//      finalKeys             - vector of extracted keys (empty ones are skipped)
 //      printableCharTreshhold - printable characters threshold
 // Returns:
-//      Best fitting key as a string
+//      Best fitting key as a string (empty if no key passes)
+// Note:
+//      Plaintext histogram of every key is summed from column histograms,
+//      so ranking never decrypts data. On equal score shorter key wins
+//      (key for a multiple of real keysize produces the same plaintext).
 //=============================================
 
-std::string getBestKey(const std::vector<std::string>& finalKeys, int chi2threshold, double printableCharTreshhold) {
+std::string getBestKey(const KeysizeHistograms& histograms, const std::vector<std::string>& finalKeys, double printableCharTreshhold) {
+    std::vector<std::vector<ByteHistogram>> columnHistograms(finalKeys.size());
+    for (size_t i = 0; i < finalKeys.size(); i++) {
+        if (!finalKeys[i].empty()) columnHistograms[i] = histograms.columns(static_cast<int>(finalKeys[i].size()));
+    }
+    return getBestKey(columnHistograms, finalKeys, printableCharTreshhold);
+}
+
+
+//=============================================
+// Pick the best key from candidates based on Chi^2 score of their plaintext
+// Takes:
+//      columnHistograms      - column histograms finalKeys[i] decrypts, for every i
+//      finalKeys             - vector of extracted keys (empty ones are skipped)
+//      printableCharTreshhold - printable characters threshold
+// Returns:
+//      Best fitting key as a string (empty if no key passes)
+// Note:
+//      Histograms may come from a sample of the data (see sampleColumnHistograms)
+// Throws:
+//      std::invalid_argument if columnHistograms and finalKeys differ in size
+//=============================================
+
+std::string getBestKey(const std::vector<std::vector<ByteHistogram>>& columnHistograms, const std::vector<std::string>& finalKeys, double printableCharTreshhold) {
+    if (columnHistograms.size() != finalKeys.size()) throw std::invalid_argument("Every key needs its column histograms");
+    XOR_STAGE_TIMER(Stage::KeySelection);
+    XOR_ALLOCATION_SCOPE(Stage::KeySelection);
     double bestKeyChi2 = std::numeric_limits<double>::max();
     std::string bestKey;
-    const bool onlyBestFit = true;
 
-    for (const auto& s : finalKeys) {
-        auto chi2 = XOR_iterateKeys_chi2(s, chi2threshold, printableCharTreshhold, onlyBestFit);
-        if (!chi2.empty() && chi2[0] < bestKeyChi2) {
-            bestKeyChi2 = chi2[0];
-            bestKey = s;
+    for (size_t i = 0; i < finalKeys.size(); i++) {
+        const std::string& key = finalKeys[i];
+        if (key.empty()) continue;
+        XOR_STAGE_COUNT(Stage::KeySelection, StageCounter::KeysScored, 1);
+        ByteHistogram plaintextHist = decodedHistogram(columnHistograms[i], key);
+        double chi2 = plaintextKeyScore(plaintextHist, printableCharTreshhold);
+        if (chi2 < 0) {
+            XOR_STAGE_COUNT(Stage::KeySelection, StageCounter::CandidatesPruned, 1);
+            continue;
+        }
+        if (chi2 < bestKeyChi2 || (chi2 == bestKeyChi2 && key.size() < bestKey.size())) {
+            bestKeyChi2 = chi2;
+            bestKey = key;
         }
     }
     return bestKey;
@@ -461,79 +1024,193 @@ std::string getBestKey(const std::vector<std::string>& finalKeys, int chi2thresh
 
 
 //=============================================
-// Get key for given keysize by single-byte XOR analysis on transposed blocks
+// Pick the best key from candidates based on Chi^2 score of sampled plaintext
 // Takes:
-//      decodedData           - ASCII input data
-//      keysize               - keysize to test
-//      chi2threshold         - Chi^2 threshold for key candidates
+//      asciiData             - encrypted ASCII data
+//      finalKeys             - vector of extracted keys (empty ones are skipped)
 //      printableCharTreshhold - printable characters threshold
 // Returns:
-//      Key string for given keysize (or empty if failed)
+//      Best fitting key as a string (empty if no key passes)
+// Note:
+//      At most keyRankingSampleSize positions are decrypted per key. Positions
+//      are drawn with a fixed seed, so every key is scored on the same sample.
 //=============================================
 
-std::string getKeyForKeysize(const std::string& decodedData, int keysize, int chi2threshold, double printableCharTreshhold) {
-
-    std::string fullKeyStr; // store full key for current keysize
-    std::vector<std::string> blocks;
+std::string getBestKey(const std::string& asciiData, const std::vector<std::string>& finalKeys, double printableCharTreshhold) {
+    const size_t keyRankingSampleSize = 1 << 16;
+    const bool sampled = asciiData.size() > keyRankingSampleSize;
 
-    for (size_t j = 0; j + keysize <= decodedData.size(); j += keysize) {   // separate the text in blocks, block length == keysize
-        blocks.push_back(decodedData.substr(j, keysize));
+    std::vector<size_t> positions;
+    if (sampled) {
+        std::mt19937_64 generator(0x5eed);
+        std::uniform_int_distribution<size_t> position(0, asciiData.size() - 1);
+        positions.resize(keyRankingSampleSize);
+        for (auto& p : positions) p = position(generator);
     }
 
-    auto transposedVector = transposeVector(blocks, keysize);   // realign blocks, so the blocks that can be deciphered by the same single-byte key are grouped
-    const bool onlyBestFit = true;
-    std::vector<int> singleXORKeys; // keys for each group of blocks
+    XOR_STAGE_TIMER(Stage::KeySelection);
 
-    for (const auto& block : transposedVector) {
-        std::string_view blockView(block);
-        auto key = XOR_iterateKeys_keys(blockView, chi2threshold, printableCharTreshhold, onlyBestFit); // find key for a group of blocks
-        if (!key.empty()) {                         // if at some point key is returned empty, that means that XOR_iterateKeys_keys couldn't find the key
-            singleXORKeys.push_back(key[0]);        // with sufficiently low chi^2 metric, which means finding key is impossible for given thresholds
-            std::cout << key[0] << " ";             // Break the loop, to avoid returning incomplete key
+    XOR_ALLOCATION_SCOPE(Stage::KeySelection);
+    double bestKeyChi2 = std::numeric_limits<double>::max();
+    std::string bestKey;
+
+    for (const auto& key : finalKeys) {
+        if (key.empty()) continue;
+        XOR_STAGE_COUNT(Stage::KeySelection, StageCounter::KeysScored, 1);
+        ByteHistogram plaintextHist{};
+        if (sampled) {
+            for (size_t p : positions) {
+                plaintextHist[static_cast<unsigned char>(asciiData[p] ^ key[p % key.size()])]++;
+            }
         }
         else {
-            std::cout << "\nWarning: Key extraction failed for block.\n";
-            singleXORKeys.clear();
-            break;
+            for (size_t p = 0; p < asciiData.size(); p++) {
+                plaintextHist[static_cast<unsigned char>(asciiData[p] ^ key[p % key.size()])]++;
+            }
+        }
+        double chi2 = plaintextKeyScore(plaintextHist, printableCharTreshhold);
+        if (chi2 < 0) {
+            XOR_STAGE_COUNT(Stage::KeySelection, StageCounter::CandidatesPruned, 1);
+            continue;
+        }
+        if (chi2 < bestKeyChi2 || (chi2 == bestKeyChi2 && key.size() < bestKey.size())) {
+            bestKeyChi2 = chi2;
+            bestKey = key;
         }
     }
+    return bestKey;
+}
 
-    if (singleXORKeys.empty()) {
-        fullKeyStr.clear();
-    }
-    else {
-        fullKeyStr.reserve(singleXORKeys.size());
 
-        for (int k : singleXORKeys) {
-            fullKeyStr += static_cast<char>(k);
-        }
+//=============================================
+// Score plaintext produced by a key
+// Takes:
+//      plaintextHist         - byte histogram of plaintext
+//      printableCharTreshhold - printable characters threshold
+// Returns:
+//      Chi^2 fit to English letter frequencies (lower is better),
+//      -1 if plaintext has too few letters and spaces
+//=============================================
+
+double plaintextKeyScore(const ByteHistogram& plaintextHist, double printableCharTreshhold) {
+    if (histogramTotal(plaintextHist) == 0) return -1;
+    if (histogramPrintableRatio(plaintextHist, 0) < printableCharTreshhold) return -1;
+    return histogramFittingQuotient(plaintextHist, 0);
+}
+
+
+//=============================================
+// Drop keys whose plaintext isn't made of English words
+// Takes:
+//      asciiData - encrypted ASCII data
+//      keys      - candidate keys (empty ones stay empty)
+// Returns:
+//      Copy of keys with every key whose plaintext fails passesWordValidation
+//      replaced by an empty key, so keys[i] keeps its index
+// Note:
+//      Opt-in second stage for prose plaintext (BreakerParams::wordValidation),
+//      the right key of logs, JSON or code may fail it. Only the first
+//      wordValidationBytes of data are decrypted per key.
+//=============================================
+
+std::vector<std::string> filterKeysByWordValidation(const std::string& asciiData, const std::vector<std::string>& keys) {
+    XOR_STAGE_TIMER(Stage::KeySelection);
+    const std::string_view prefix = std::string_view(asciiData).substr(0, wordValidationBytes);
+    std::vector<std::string> validated = keys;
+    for (auto& key : validated) {
+        if (key.empty() || passesWordValidation(XOR_repeatingKeyEncrypt(prefix, key))) continue;
+        XOR_STAGE_COUNT(Stage::KeySelection, StageCounter::CandidatesPruned, 1);
+        key.clear();
     }
+    return validated;
+}
+
+
+//=============================================
+// Get key for given keysize by single-byte XOR analysis of key columns
+// Takes:
+//      decodedData           - ASCII input data
+//      keysize               - keysize to test
+//      chi2threshold         - Chi^2 threshold for key candidates
+//      printableCharTreshhold - printable characters threshold
+// Returns:
+//      Key string for given keysize
+// Note:
+//      Column histograms are built in a single pass over the data, so each
+//      byte is read once and nothing proportional to input size is allocated.
+//      Trailing bytes that don't fill a whole block are counted too.
+//      If columns are shorter than minFrequencyAnalysisColumnLength or any column
+//      fails the thresholds, the key is found by beam search with bigram
+//      statistics across columns instead.
+//=============================================
 
+std::string getKeyForKeysize(const std::string& decodedData, int keysize, int chi2threshold, double printableCharTreshhold) {
+    std::string fullKeyStr;
+    if (decodedData.size() / keysize >= minFrequencyAnalysisColumnLength) {
+        auto columnHistograms = buildColumnHistograms(decodedData, keysize);   // byte counts of groups of bytes that can be deciphered by the same single-byte key
+        fullKeyStr = getKeyFromColumnHistograms(columnHistograms, chi2threshold, printableCharTreshhold);
+    }
+    if (fullKeyStr.empty())     // columns too short for frequency analysis alone
+        fullKeyStr = refineKeyBeamSearch(decodedData, keysize, defaultBeamCandidates, defaultBeamWidth);
     return fullKeyStr;
 }
 
 
 //=============================================
-// Get candidate keysizes based on normalized Hamming distance analysis
+// Get key from column histograms of one keysize
+// Takes:
+//      columnHistograms      - byte histogram of every key column
+//      chi2threshold         - Chi^2 threshold for key candidates, a column whose best
+//                              byte reaches it is decided by unigram log-likelihood
+//                              among its chi2FallbackCandidates lowest-Chi^2 bytes
+//      printableCharTreshhold - printable characters threshold
+// Returns:
+//      Key string, one byte per column (or empty if failed)
+// Note:
+//      Columns are independent and analyzed concurrently on the default
+//      thread pool, each writes its key byte to a preallocated slot.
+//      Every column reports KeyByteFound or ColumnFailed trace event.
+//=============================================
+
+std::string getKeyFromColumnHistograms(const std::vector<ByteHistogram>& columnHistograms, int chi2threshold, double printableCharTreshhold) {
+    double confidence = 0;
+    return keyFromColumnHistograms(columnHistograms, chi2threshold, printableCharTreshhold, confidence);
+}
+
+
+//=============================================
+// Get candidate keysizes by adaptive index of coincidence search
 // Takes:
 //      asciiData   - ASCII input string
 //      noOfKeysizes - number of candidate keysizes to return
 // Returns:
 //      Vector of candidate keysizes
+// Note:
+//      Search range and sample grow only while the top keysize is ambiguous,
+//      see findKeysizesAdaptive
 //============================================
 
 std::vector<int> getCandidateKeysizes(const std::string& asciiData, int noOfKeysizes) {
-    // The number of candidate keysizes is defined by noOfKeysizes
-    const int minKeysize = 2;
-    const int maxKeysize = 40;
-    const int noOfBlockPairs = 4;
-    std::vector<int> candidateKeysizes = findLikelyKeysizes(asciiData, minKeysize, maxKeysize, noOfBlockPairs, noOfKeysizes);
+    std::vector<int> candidateKeysizes = findKeysizesAdaptive(asciiData, noOfKeysizes).keysizes;
 
-    std::cout << "Candidate keysizes: ";
-    for (int keysize : candidateKeysizes) {
-        std::cout << keysize << " ";
-    }
-    std::cout << "\n";
+    XOR_TRACE(TraceEvent::keysizesRanked(candidateKeysizes));
+    return candidateKeysizes;
+}
+
+
+//=============================================
+// Get candidate keysizes based on index of coincidence
+// Takes:
+//      histograms   - column histograms of all keysizes in search range
+//      noOfKeysizes - number of candidate keysizes to return
+// Returns:
+//      Vector of candidate keysizes
+//============================================
+
+std::vector<int> getCandidateKeysizes(const KeysizeHistograms& histograms, int noOfKeysizes) {
+    std::vector<int> candidateKeysizes = rankKeysizesByCoincidence(histograms, noOfKeysizes);
+
+    XOR_TRACE(TraceEvent::keysizesRanked(candidateKeysizes));
     return candidateKeysizes;
 }
 
@@ -551,8 +1228,52 @@ std::vector<int> getCandidateKeysizes(const std::string& asciiData, int noOfKeys
 //=============================================
 
 std::string getFullKeyFromGroupedBlocks(const std::string& asciiData, int candidateKeysize, int chi2threshold, int noOfKeysizes, double printableCharTreshhold) {
-    std::cout << "\nSingle XOR keys for keysize == " << candidateKeysize << ": \n";
     std::string fullKeyStr = getKeyForKeysize(asciiData, candidateKeysize, chi2threshold, printableCharTreshhold);
-    std::cout << "\nKey for keysize = " << std::to_string(candidateKeysize) << ": " << fullKeyStr << "\n";
+    XOR_TRACE(TraceEvent::keyFound(candidateKeysize, fullKeyStr));
+    return fullKeyStr;
+}
+
+
+// Same as above, but candidate keysize columns come from multi-keysize histograms
+
+std::string getFullKeyFromGroupedBlocks(const KeysizeHistograms& histograms, int candidateKeysize, int chi2threshold, double printableCharTreshhold) {
+    std::string fullKeyStr = getKeyFromColumnHistograms(histograms.columns(candidateKeysize), chi2threshold, printableCharTreshhold);
+    XOR_TRACE(TraceEvent::keyFound(candidateKeysize, fullKeyStr));
     return fullKeyStr;
+}
+
+
+//=============================================
+// Print single XOR keys and full key found for a keysize
+// Takes:
+//      keysize - tested keysize
+//      key     - extracted key (empty if extraction failed)
+// Note:
+//      Used by ConsoleTraceSink, the library itself never prints
+//=============================================
+
+void printKeyForKeysize(int keysize, const std::string& key) {
+    std::cout << "\nSingle XOR keys for keysize == " << keysize << ": \n";
+    if (key.empty()) {
+        std::cout << "\nWarning: Key extraction failed for block.\n";
+    }
+    for (char k : key) {
+        std::cout << static_cast<int>(static_cast<unsigned char>(k)) << " ";
+    }
+    std::cout << "\nKey for keysize = " << std::to_string(keysize) << ": " << key << "\n";
+}
+
+
+//=============================================
+// Print candidate keysizes
+// Takes:
+//      candidateKeysizes - keysizes to print, best first
+//=============================================
+
+void printCandidateKeysizes(const std::vector<int>& candidateKeysizes) {
+    std::cout << "Candidate keysizes: ";
+    for (int keysize : candidateKeysizes) {
+        std::cout << keysize << " ";
+    }
+    std::cout << "\n";
 }
\ No newline at end of file
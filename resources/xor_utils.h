@@ -3,6 +3,10 @@
 
 #include <string>
 #include <vector>
+#include "column_stats.h"
+#include "key_refinement.h"
+#include "known_plaintext.h"
+#include "threshold_calibration.h"
 
 // =======================
 // XOR UTILS HEADER
@@ -43,6 +47,19 @@ std::vector<std::string> XOR_iterateKeys_str(std::string_view inputStr, int chi2
 std::vector<int> XOR_iterateKeys_keys(std::string_view inputStr, int chi2threshold, double printableCharTreshhold, bool onlyBestFit);
 std::vector<double> XOR_iterateKeys_chi2(std::string_view inputStr, int chi2threshold, double printableCharTreshhold, bool onlyBestFit);
 
+// Histogram based counterpart of XOR_iterateKeys_keys: scores every key directly from
+// byte counts of a column, so the column never has to be copied or decoded
+std::vector<int> XOR_iterateKeys_hist(const ByteHistogram& hist, int chi2threshold, double printableCharTreshhold, bool onlyBestFit);
+
+// Chi^2 fitting quotient and letter/space ratio of a column decoded with given key, computed from its histogram
+double histogramFittingQuotient(const ByteHistogram& hist, int key);
+double histogramPrintableRatio(const ByteHistogram& hist, int key);
+
+// Confidence of a key: smallest relative Chi^2 gap between chosen key byte and runner-up
+// over all columns (0 - another byte fits as well, 1 - no other byte comes close).
+// Runner-ups must pass printableCharTreshhold; key ^ 0x20 (same text, other case) isn't one.
+double keyConfidence(const std::vector<ByteHistogram>& columnHistograms, std::string_view key, double printableCharTreshhold);
+
 // Calculates a fitting quotient measuring how well input matches expected English letter frequencies
 double singleKeyFittingQuotient(std::string_view inputStr);
 double singleCharFittingQuotient(int inputStrLetterOccurance, int strLen, char letter);
@@ -60,13 +77,58 @@ std::string XOR_repeatingKeyEncrypt(std::string_view inputStr, std::string_view
 
 // ============ FUNCTIONS FOR BREAKING REPEATING KEY XOR ==============
 
+// Pass as chi2threshold / printableCharTreshhold of the positional breaking functions
+// to take that threshold from the threshold config (see threshold_calibration.h)
+constexpr int configuredChi2threshold = -1;
+constexpr double configuredPrintableCharTreshhold = -1.0;
+
 // Breaks repeating-key XOR encryption by:
-//  - Finding candidate keysizes via normalized Hamming distance
-//  - Extracting candidate keys for each keysizes
+//  - Finding candidate keysizes via index of coincidence, widening keysize range
+//    and sample only until the best keysize stands out
+//  - Building column histograms of candidate keysizes in one pass over the data
+//    (from a stratified sample for huge inputs)
+//  - Extracting candidate keys for each keysizes (beam search for short columns)
 //  - Selecting the best key via Chi^2 statistics
+//  - Refining it by hill climbing with quadgram fitness if its confidence is low
 //  - Returning decrypted plaintext string
+// Nothing is printed, progress is reported as trace events (see trace.h)
 std::string XOR_breakRepeatingKey(const std::string& asciiData, int chi2threshold, int noOfKeysizes, double printableCharTreshhold);
 
+// Same, but the key is first derived from known plaintext crib at cribOffset (or anywhere for
+// unknownCribOffset, see known_plaintext.h); statistics are used only if the crib gives no key
+std::string XOR_breakRepeatingKey(const std::string& asciiData, std::string_view crib, size_t cribOffset, int chi2threshold, int noOfKeysizes, double printableCharTreshhold);
+
+// Key found by breaking repeating-key XOR
+struct BreakResult {
+    int keysize = 0;            // 0 if no key was found
+    std::string key;
+    double confidence = 0;      // 0-1, probability that keysize and every key byte are right
+};
+
+// Tunable parameters of the breaker, set1 values by default
+struct BreakerParams {
+    int chi2threshold = ThresholdConfig{}.chi2threshold;    // columns whose best Chi^2 reaches it are decided by unigram fit
+    double printableCharTreshhold = ThresholdConfig{}.printableCharTreshhold;
+    int noOfKeysizes = 3;
+    KeysizeSearchLimits keysizeSearch;              // keysize range and sample of keysize detection
+    size_t refinementBytes = maxRefinementBytes;    // prefix of data beam search and hill climbing score
+    std::string crib;                               // known plaintext, empty for none
+    size_t cribOffset = unknownCribOffset;          // position of crib in the plaintext
+    bool wordValidation = false;                    // keys must decrypt to English words (prose plaintext only)
+};
+
+// BreakerParams with thresholds from the threshold config (see threshold_calibration.h),
+// throws std::runtime_error if the config file is malformed
+BreakerParams configuredBreakerParams();
+
+// Same steps as XOR_breakRepeatingKey, but returns the key instead of decrypting
+BreakResult XOR_findRepeatingKey(const std::string& asciiData, int chi2threshold, int noOfKeysizes, double printableCharTreshhold);
+BreakResult XOR_findRepeatingKey(const std::string& asciiData, const BreakerParams& params);
+
+// Key derived from params.crib alone: smallest keysize of the keysize search range whose keystream
+// the crib repeats (keysize 0 if there is none), no keysize ranking or column analysis
+BreakResult XOR_findKeyFromCrib(const std::string& asciiData, const BreakerParams& params);
+
 // Computes Hamming distance (bit difference) between two strings
 int getHammingDistance(std::string_view inputStr1, std::string_view inputStr2);
 
@@ -76,16 +138,46 @@ std::vector<int> findLikelyKeysizes(const std::string_view inputStr, int minKeys
 // Transposes blocks of ciphertext to group bytes encrypted with the same key byte
 std::vector<std::string> transposeVector(const std::vector<std::string>& blocks, int keysize);
 
-// Picks the best candidate key from a set based on Chi^2 fit to English letter frequencies
-std::string getBestKey(const std::vector<std::string>& finalKeys, int chi2threshold, double printableCharTreshhold);
+// Picks the candidate key whose plaintext fits English letter frequencies best (lowest Chi^2)
+// Plaintext statistics come from column histograms, nothing is decrypted (O(keysize * 256) per key)
+std::string getBestKey(const KeysizeHistograms& histograms, const std::vector<std::string>& finalKeys, double printableCharTreshhold);
+
+// Same as above, with column histograms given per key: columnHistograms[i] belongs to finalKeys[i]
+std::string getBestKey(const std::vector<std::vector<ByteHistogram>>& columnHistograms, const std::vector<std::string>& finalKeys, double printableCharTreshhold);
+
+// Same as above, but plaintext statistics come from a bounded random sample of decrypted positions
+std::string getBestKey(const std::string& asciiData, const std::vector<std::string>& finalKeys, double printableCharTreshhold);
 
-// Extracts the repeating key for a given keysize by single-byte XOR analysis of transposed blocks
+// Opt-in second stage for prose plaintext: keys whose plaintext fails dictionary word validation
+// (see word_validation.h) are replaced by empty keys, which getBestKey skips
+std::vector<std::string> filterKeysByWordValidation(const std::string& asciiData, const std::vector<std::string>& keys);
+
+// Chi^2 of the plaintext a key produces, or -1 if it doesn't pass printable characters threshold
+double plaintextKeyScore(const ByteHistogram& plaintextHist, double printableCharTreshhold);
+
+// Extracts the repeating key for a given keysize by single-byte XOR analysis of its key columns
+// (falls back to beam search with bigram statistics when a column can't be solved alone)
 std::string getKeyForKeysize(const std::string& decodedData, int keysize, int chi2threshold, double printableCharTreshhold);
 
-// Returns candidate keysizes based on normalized Hamming distance ranking
+// Extracts the repeating key from already built column histograms of one keysize (columns analyzed in parallel)
+std::string getKeyFromColumnHistograms(const std::vector<ByteHistogram>& columnHistograms, int chi2threshold, double printableCharTreshhold);
+
+// Returns candidate keysizes found by adaptive index of coincidence search (see findKeysizesAdaptive)
 std::vector<int> getCandidateKeysizes(const std::string& asciiData, int noOfKeysizes);
 
+// Returns candidate keysizes based on index of coincidence of multi-keysize column histograms
+std::vector<int> getCandidateKeysizes(const KeysizeHistograms& histograms, int noOfKeysizes);
+
 // Extracts full repeating key from grouped blocks for a given candidate keysize
 std::string getFullKeyFromGroupedBlocks(const std::string& asciiData, int candidateKeysize, int chi2threshold, int noOfKeysizes, double printableCharTreshhold);
 
+// Same as above, but reads columns of candidate keysize from multi-keysize histograms
+std::string getFullKeyFromGroupedBlocks(const KeysizeHistograms& histograms, int candidateKeysize, int chi2threshold, double printableCharTreshhold);
+
+// Prints single XOR keys and full key found for a keysize
+void printKeyForKeysize(int keysize, const std::string& key);
+
+// Prints candidate keysizes on one line
+void printCandidateKeysizes(const std::vector<int>& candidateKeysizes);
+
 #endif // XOR_UTILS_H
\ No newline at end of file
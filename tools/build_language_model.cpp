@@ -0,0 +1,92 @@
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "language_model.h"
+
+// =======================
+// LANGUAGE MODEL BUILDER
+// Trains unigram/bigram byte statistics from corpus files (logs, JSON, source
+// code, ...) and writes the binary model file that the library memory-maps
+// at startup (see language_model.h). Files are streamed, so the corpus may be
+// larger than memory.
+//
+// Example:
+//  build_language_model --out xor_language_model.bin logs/*.log
+//=======================
+
+namespace {
+
+    struct Options {
+        std::vector<std::string> inputs;
+        std::string outFile = defaultLanguageModelPath();
+        bool foldCase = false;
+    };
+
+    void usage(int exitCode) {
+        std::cout << "Usage: build_language_model [--out xor_language_model.bin] [--fold-case] file...\n";
+        std::exit(exitCode);
+    }
+
+    Options parseOptions(int argc, char** argv) {
+        Options options;
+        for (int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+            if (arg == "--out") {
+                if (i + 1 >= argc) throw std::invalid_argument("Missing value for " + arg);
+                options.outFile = argv[++i];
+            }
+            else if (arg == "--fold-case") options.foldCase = true;
+            else if (arg == "--help") usage(0);
+            else if (!arg.empty() && arg[0] == '-') usage(1);
+            else options.inputs.push_back(arg);
+        }
+        if (options.inputs.empty()) usage(1);
+        return options;
+    }
+}
+
+
+int main(int argc, char** argv)
+{
+    try {
+        Options options = parseOptions(argc, argv);
+        ByteLanguageModelTrainer trainer(options.foldCase);
+
+        std::vector<char> buffer(1 << 20);
+        for (const std::string& input : options.inputs) {
+            std::ifstream file(input, std::ios::binary);
+            if (!file.is_open()) {
+                throw std::runtime_error("Error: Could not open file " + input);
+            }
+            while (file.read(buffer.data(), buffer.size()) || file.gcount() > 0) {
+                trainer.add(std::string_view(buffer.data(), static_cast<size_t>(file.gcount())));
+            }
+        }
+        if (trainer.size() == 0) {
+            throw std::runtime_error("Error: Corpus is empty");
+        }
+
+        ByteLanguageModel model = trainer.build();
+        saveByteLanguageModel(options.outFile, model);
+
+        // Unigram entropy shows how far the corpus is from uniform bytes (8 bits)
+        double entropy = 0;
+        for (int b = 0; b < 256; b++) {
+            double p = std::exp(static_cast<double>(model.unigram[b]));
+            entropy -= p * std::log2(p);
+        }
+        std::printf("Trained on %llu bytes from %zu files, unigram entropy %.2f bits/byte\n",
+            static_cast<unsigned long long>(trainer.size()), options.inputs.size(), entropy);
+        std::printf("Written to %s\n", options.outFile.c_str());
+    }
+    catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,83 @@
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include "common_utils.h"
+#include "language_model.h"
+#include "threshold_calibration.h"
+
+// =======================
+// THRESHOLD CALIBRATION TOOL
+// Learns chi2threshold and printableCharTreshhold from sample plaintext for a
+// target false-reject rate (see threshold_calibration.h), prints how many
+// wrong keys they let through compared with the built-in values, and writes
+// the config file the library loads on startup.
+//
+// Example:
+//  calibrate_thresholds --sample english.txt --false-reject 0.01 --out xor_thresholds.cfg
+//=======================
+
+namespace {
+
+    struct Options {
+        CalibrationOptions calibration;
+        std::string sampleFile;                 // empty == embedded English sample
+        std::string outFile = defaultThresholdConfigPath();
+    };
+
+    void usage(int exitCode) {
+        std::cout << "Usage: calibrate_thresholds [--sample file.txt] [--false-reject 0.01] [--trials 20000]\n"
+            "                            [--min-length 20] [--max-length 200] [--max-stride 40] [--seed 1]\n"
+            "                            [--out xor_thresholds.cfg]\n";
+        std::exit(exitCode);
+    }
+
+    Options parseOptions(int argc, char** argv) {
+        Options options;
+        for (int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+            auto value = [&]() -> std::string {
+                if (i + 1 >= argc) throw std::invalid_argument("Missing value for " + arg);
+                return argv[++i];
+            };
+            if (arg == "--sample") options.sampleFile = value();
+            else if (arg == "--false-reject") options.calibration.falseRejectRate = std::stod(value());
+            else if (arg == "--trials") options.calibration.trials = std::stoul(value());
+            else if (arg == "--min-length") options.calibration.minColumnLength = std::stoul(value());
+            else if (arg == "--max-length") options.calibration.maxColumnLength = std::stoul(value());
+            else if (arg == "--max-stride") options.calibration.maxStride = std::stoi(value());
+            else if (arg == "--seed") options.calibration.seed = std::stoull(value());
+            else if (arg == "--out") options.outFile = value();
+            else usage(arg == "--help" ? 0 : 1);
+        }
+        return options;
+    }
+}
+
+
+int main(int argc, char** argv)
+{
+    try {
+        Options options = parseOptions(argc, argv);
+        std::string sample = options.sampleFile.empty() ? std::string(englishSampleText()) : readFile(options.sampleFile);
+
+        CalibrationReport report = calibrateThresholds(sample, options.calibration);
+        const ThresholdConfig builtIn;
+        std::printf("Columns sampled: %zu (length %zu-%zu, stride 1-%d)\n", report.trials,
+            options.calibration.minColumnLength, options.calibration.maxColumnLength, options.calibration.maxStride);
+        std::printf("%-12s %8s %10s %14s %16s\n", "", "chi2", "printable", "false rejects", "wrong keys/col");
+        std::printf("%-12s %8d %10.2f %13.2f%% %16.2f\n", "built-in", builtIn.chi2threshold, builtIn.printableCharTreshhold,
+            100 * report.defaultFalseRejectRate, report.defaultCandidatesPerColumn);
+        std::printf("%-12s %8d %10.2f %13.2f%% %16.2f\n", "calibrated", report.thresholds.chi2threshold, report.thresholds.printableCharTreshhold,
+            100 * report.falseRejectRate, report.candidatesPerColumn);
+
+        saveThresholdConfig(options.outFile, report.thresholds);
+        std::printf("Written to %s\n", options.outFile.c_str());
+    }
+    catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
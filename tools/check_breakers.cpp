@@ -0,0 +1,267 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "batch_breaker.h"
+#include "common_utils.h"
+#include "corpus_generator.h"
+#include "crib_search.h"
+#include "streaming_breaker.h"
+#include "xor_utils.h"
+
+// =======================
+// FRONT END CHECK TOOL
+// Breaks a generated corpus (see corpus_generator.h, every record's key is
+// known) with XOR_findRepeatingKey and with the front ends that wrap the same
+// statistics, and reports for each: records whose key it fully recovered,
+// records where it returns the same key as XOR_findRepeatingKey, wall time.
+//  - StreamingKeyBreaker: every record appended in --chunk-bytes chunks
+//  - breakBatch: all records as one batch of in-memory jobs
+// Crib search (set1/4 prefilter) is checked on separate single-byte XOR lines
+// mixed with as many random lines: the key most hits of a line name is
+// compared with the line's key and with the lowest-Chi^2 key
+// (XOR_iterateKeys_keys), random lines should get no hits.
+//
+// Exits with 1 if a front end recovers fewer keys than XOR_findRepeatingKey
+// or crib hits name a wrong key, so it can be run as an accuracy check, e.g.
+//  check_breakers --records 40 --record-bytes 16K --min-key-length 2 --max-key-length 40
+//=======================
+
+namespace {
+
+    struct Options {
+        CorpusSpec corpus;
+        uint64_t records = 40;
+        int minKeyLength = 2;
+        int maxKeyLength = 40;
+        uint64_t chunkBytes = 4096;
+        uint64_t cribLines = 300;
+        uint64_t cribLineBytes = 60;
+        std::string sourceFile;
+    };
+
+    // Whole records of the corpus with their keys
+    struct Corpus {
+        std::vector<std::string> ciphertexts;
+        std::vector<std::string> keys;
+    };
+
+    struct Tally {
+        std::string name;
+        size_t recovered = 0;       // keys equal to the record's key
+        size_t agreeing = 0;        // keys equal to XOR_findRepeatingKey's
+        double seconds = 0;
+    };
+
+    void usage(int exitCode) {
+        std::cout << "Usage: check_breakers [--seed 1] [--records 40] [--record-bytes 16K] [--min-key-length 2]\n"
+            "                      [--max-key-length 40] [--chunk-bytes 4K] [--crib-lines 300] [--crib-line-bytes 60]\n"
+            "                      [--source file.txt]\n";
+        std::exit(exitCode);
+    }
+
+    Options parseOptions(int argc, char** argv) {
+        Options options;
+        options.corpus.recordBytes = 16 * 1024;
+        for (int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+            auto value = [&]() -> std::string {
+                if (i + 1 >= argc) throw std::invalid_argument("Missing value for " + arg);
+                return argv[++i];
+            };
+            if (arg == "--seed") options.corpus.seed = std::stoull(value());
+            else if (arg == "--records") options.records = std::stoull(value());
+            else if (arg == "--record-bytes") options.corpus.recordBytes = parseSize(value());
+            else if (arg == "--min-key-length") options.minKeyLength = std::stoi(value());
+            else if (arg == "--max-key-length") options.maxKeyLength = std::stoi(value());
+            else if (arg == "--chunk-bytes") options.chunkBytes = parseSize(value());
+            else if (arg == "--crib-lines") options.cribLines = std::stoull(value());
+            else if (arg == "--crib-line-bytes") options.cribLineBytes = parseSize(value());
+            else if (arg == "--source") options.sourceFile = value();
+            else usage(arg == "--help" ? 0 : 1);
+        }
+        if (options.minKeyLength < 1 || options.maxKeyLength < options.minKeyLength || options.chunkBytes == 0 || options.cribLineBytes == 0) {
+            throw std::invalid_argument("Invalid key length range, chunk size or crib line size");
+        }
+        options.corpus.keyLengths.clear();
+        for (int k = options.minKeyLength; k <= options.maxKeyLength; k++) options.corpus.keyLengths.push_back(k);
+        options.corpus.totalBytes = options.records * options.corpus.recordBytes;
+        return options;
+    }
+
+    Corpus generateCorpus(const CorpusSpec& spec, const std::string& source) {
+        Corpus corpus;
+        CorpusGenerator generator(spec, source);
+        CorpusPiece piece;
+        while (generator.next(piece)) {
+            if (piece.offset == 0) {
+                corpus.ciphertexts.emplace_back();
+                corpus.keys.push_back(piece.key);
+            }
+            corpus.ciphertexts.back() += piece.ciphertext;
+        }
+        return corpus;
+    }
+
+    // Keys a front end found, one per record, and the wall time it took
+    struct Run {
+        std::vector<std::string> keys;
+        double seconds = 0;
+    };
+
+    template <typename BreakAll>
+    Run timedRun(BreakAll breakAll) {
+        Run run;
+        auto start = std::chrono::steady_clock::now();
+        run.keys = breakAll();
+        run.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        return run;
+    }
+
+    Tally tallyRun(const std::string& name, const Run& run, const Corpus& corpus, const std::vector<std::string>& referenceKeys) {
+        Tally tally;
+        tally.name = name;
+        tally.seconds = run.seconds;
+        for (size_t i = 0; i < corpus.keys.size(); i++) {
+            if (run.keys[i] == corpus.keys[i]) tally.recovered++;
+            if (run.keys[i] == referenceKeys[i]) tally.agreeing++;
+        }
+        return tally;
+    }
+
+    // Crib search outcome on English lines (single-byte keys) and random lines
+    struct CribTally {
+        size_t englishLines = 0;
+        size_t linesWithHits = 0;
+        size_t rightKeys = 0;           // lines whose most named key is their key
+        size_t chi2RightKeys = 0;       // lines whose lowest-Chi^2 key is their key
+        size_t randomLinesWithHits = 0;
+        double seconds = 0;
+    };
+
+    CribTally checkCribs(const Options& options, const std::string& source) {
+        CorpusSpec spec;
+        spec.seed = options.corpus.seed;
+        spec.recordBytes = options.cribLineBytes;
+        spec.totalBytes = options.cribLines * options.cribLineBytes;
+        spec.keyLengths = { 1 };
+        const Corpus english = generateCorpus(spec, source);
+
+        // Random lines after the English ones, like the decoys of set1/4
+        std::vector<std::string> lines = english.ciphertexts;
+        uint64_t state = spec.seed;
+        for (size_t i = 0; i < english.ciphertexts.size(); i++) {
+            std::string line(options.cribLineBytes, '\0');
+            for (char& c : line) c = static_cast<char>(nextSplitMix64(state));
+            lines.push_back(std::move(line));
+        }
+
+        CribTally tally;
+        auto start = std::chrono::steady_clock::now();
+        std::vector<CribHit> hits = findCribs(lines);
+        tally.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        std::vector<std::map<int, size_t>> votes(lines.size());
+        for (const CribHit& hit : hits) votes[hit.line][hit.key]++;
+        const BreakerParams params;
+        for (size_t i = 0; i < lines.size(); i++) {
+            if (votes[i].empty()) continue;
+            if (i >= english.keys.size()) {
+                tally.randomLinesWithHits++;
+                continue;
+            }
+            tally.linesWithHits++;
+            auto named = std::max_element(votes[i].begin(), votes[i].end(), [](const auto& a, const auto& b) { return a.second < b.second; });
+            if (named->first == static_cast<unsigned char>(english.keys[i][0])) tally.rightKeys++;
+        }
+        tally.englishLines = english.keys.size();
+        for (size_t i = 0; i < english.keys.size(); i++) {
+            std::vector<int> chi2Keys = XOR_iterateKeys_keys(lines[i], params.chi2threshold, params.printableCharTreshhold, true);
+            if (!chi2Keys.empty() && chi2Keys[0] == static_cast<unsigned char>(english.keys[i][0])) tally.chi2RightKeys++;
+        }
+        return tally;
+    }
+
+    void printTally(const Tally& tally, size_t records) {
+        std::printf("%-24s %5zu/%-5zu %5zu/%-5zu %9.3fs\n", tally.name.c_str(), tally.recovered, records, tally.agreeing, records, tally.seconds);
+    }
+}
+
+
+int main(int argc, char** argv)
+{
+    try {
+        Options options = parseOptions(argc, argv);
+        std::string source = options.sourceFile.empty() ? std::string(englishSampleText()) : readFile(options.sourceFile);
+        const Corpus corpus = generateCorpus(options.corpus, source);
+        const size_t records = corpus.keys.size();
+        const KeysizeSearchLimits limits;
+
+        const Run reference = timedRun([&] {
+            std::vector<std::string> keys;
+            for (const std::string& ciphertext : corpus.ciphertexts) keys.push_back(XOR_findRepeatingKey(ciphertext, BreakerParams{}).key);
+            return keys;
+            });
+        const Tally referenceTally = tallyRun("XOR_findRepeatingKey", reference, corpus, reference.keys);
+
+        std::vector<Tally> frontEnds;
+        frontEnds.push_back(tallyRun("StreamingKeyBreaker", timedRun([&] {
+            std::vector<std::string> keys;
+            for (const std::string& ciphertext : corpus.ciphertexts) {
+                StreamingKeyBreaker breaker(limits.minKeysize, limits.maxKeysize);
+                for (size_t offset = 0; offset < ciphertext.size(); offset += options.chunkBytes) {
+                    breaker.append(std::string_view(ciphertext).substr(offset, options.chunkBytes));
+                }
+                keys.push_back(breaker.bestKey());
+            }
+            return keys;
+            }), corpus, reference.keys));
+        frontEnds.push_back(tallyRun("breakBatch", timedRun([&] {
+            std::vector<BatchJob> jobs(records);
+            for (size_t i = 0; i < records; i++) {
+                jobs[i].id = std::to_string(i);
+                jobs[i].data = corpus.ciphertexts[i];
+            }
+            std::vector<std::string> keys(records);
+            const BreakerParams params;
+            breakBatch(jobs, [&](const BatchResult& result) { keys[std::stoul(result.id)] = result.key; },
+                params.chi2threshold, params.noOfKeysizes, params.printableCharTreshhold);
+            return keys;
+            }), corpus, reference.keys));
+
+        std::printf("%-24s %11s %11s %10s\n", "front end", "recovered", "agreeing", "time");
+        printTally(referenceTally, records);
+        bool passed = true;
+        for (const Tally& tally : frontEnds) {
+            printTally(tally, records);
+            if (tally.recovered < referenceTally.recovered) passed = false;
+        }
+
+        const CribTally cribs = checkCribs(options, source);
+        std::printf("\nfindCribs on %zu single-byte XOR lines of %llu B and as many random lines (%.2f ms):\n",
+            cribs.englishLines, static_cast<unsigned long long>(options.cribLineBytes), cribs.seconds * 1000);
+        std::printf("  lines with hits %zu, right key %zu (lowest Chi^2 right on %zu), random lines with hits %zu\n",
+            cribs.linesWithHits, cribs.rightKeys, cribs.chi2RightKeys, cribs.randomLinesWithHits);
+
+        if (!passed) {
+            std::printf("\nFAILED: a front end recovers fewer keys than XOR_findRepeatingKey\n");
+            return 1;
+        }
+        if (cribs.rightKeys < cribs.linesWithHits) {
+            std::printf("\nFAILED: crib hits name a wrong key\n");
+            return 1;
+        }
+    }
+    catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
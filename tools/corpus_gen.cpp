@@ -0,0 +1,164 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "common_utils.h"
+#include "converters.h"
+#include "corpus_generator.h"
+
+// =======================
+// CORPUS GENERATOR TOOL
+// Writes a synthetic ciphertext corpus (see corpus_generator.h) and its
+// ground truth:
+//  - ciphertext file: one record per line as hex or base64 (like 4.txt),
+//    optionally wrapped (like 6.txt), or raw records back to back
+//  - truth file: "record keysize key_hex bytes" per record, tab separated
+//  - plaintext file (optional): records back to back
+//
+// Examples:
+//  4.txt-like:  corpus_gen --size 9K --record-bytes 30 --key-lengths 1 --encoding hex --out 4.txt
+//  6.txt-like:  corpus_gen --size 3K --record-bytes 3K --key-lengths 2-40 --encoding base64 --line-length 60
+//  scaling:     corpus_gen --size 20G --record-bytes 1G --key-lengths 29 --encoding raw --out big.bin
+//=======================
+
+namespace {
+
+    struct Options {
+        CorpusSpec spec;
+        std::string encoding = "hex";
+        size_t lineLength = 0;                  // 0 == a whole record on one line
+        std::string sourceFile;
+        std::string outFile;                    // empty == stdout
+        std::string truthFile;
+        std::string plaintextFile;
+    };
+
+    // "29", "2-40" or "3,5,29"
+    std::vector<int> parseKeyLengths(const std::string& text) {
+        std::vector<int> lengths;
+        size_t start = 0;
+        while (start < text.size()) {
+            size_t end = text.find(',', start);
+            std::string item = text.substr(start, end == std::string::npos ? std::string::npos : end - start);
+            size_t dash = item.find('-');
+            if (dash == std::string::npos) {
+                lengths.push_back(std::stoi(item));
+            }
+            else {
+                for (int k = std::stoi(item.substr(0, dash)); k <= std::stoi(item.substr(dash + 1)); k++) lengths.push_back(k);
+            }
+            if (end == std::string::npos) break;
+            start = end + 1;
+        }
+        return lengths;
+    }
+
+    void usage(int exitCode) {
+        std::cout << "Usage: corpus_gen [--seed 1] [--size 1M] [--record-bytes 4K] [--key-lengths 1|2-40|3,5,29]\n"
+            "                  [--encoding hex|base64|raw] [--line-length 0] [--source file.txt]\n"
+            "                  [--out file] [--truth file] [--plaintext file]\n";
+        std::exit(exitCode);
+    }
+
+    Options parseOptions(int argc, char** argv) {
+        Options options;
+        for (int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+            auto value = [&]() -> std::string {
+                if (i + 1 >= argc) throw std::invalid_argument("Missing value for " + arg);
+                return argv[++i];
+            };
+            if (arg == "--seed") options.spec.seed = std::stoull(value());
+            else if (arg == "--size") options.spec.totalBytes = parseSize(value());
+            else if (arg == "--record-bytes") options.spec.recordBytes = parseSize(value());
+            else if (arg == "--key-lengths") options.spec.keyLengths = parseKeyLengths(value());
+            else if (arg == "--encoding") options.encoding = value();
+            else if (arg == "--line-length") options.lineLength = std::stoul(value());
+            else if (arg == "--source") options.sourceFile = value();
+            else if (arg == "--out") options.outFile = value();
+            else if (arg == "--truth") options.truthFile = value();
+            else if (arg == "--plaintext") options.plaintextFile = value();
+            else usage(arg == "--help" ? 0 : 1);
+        }
+        if (options.encoding != "hex" && options.encoding != "base64" && options.encoding != "raw") {
+            throw std::invalid_argument("Unknown encoding: " + options.encoding);
+        }
+        return options;
+    }
+
+    std::unique_ptr<std::ofstream> openOutput(const std::string& filename) {
+        auto file = std::make_unique<std::ofstream>(filename, std::ios::binary);
+        if (!file->is_open()) {
+            throw std::runtime_error("Error: Could not open file " + filename);
+        }
+        return file;
+    }
+}
+
+
+int main(int argc, char** argv)
+{
+    try {
+        Options options = parseOptions(argc, argv);
+        std::string source = options.sourceFile.empty() ? std::string(englishSampleText()) : readFile(options.sourceFile);
+        CorpusGenerator generator(options.spec, source);
+
+        std::unique_ptr<std::ofstream> outFile = options.outFile.empty() ? nullptr : openOutput(options.outFile);
+        std::ostream& out = outFile ? *outFile : std::cout;
+        std::unique_ptr<std::ofstream> truth = options.truthFile.empty() ? nullptr : openOutput(options.truthFile);
+        std::unique_ptr<std::ofstream> plaintext = options.plaintextFile.empty() ? nullptr : openOutput(options.plaintextFile);
+        if (truth) *truth << "# record\tkeysize\tkey_hex\tbytes\n";
+
+        CorpusPiece piece;
+        uint64_t recordBytes = 0;
+        size_t column = 0;                      // characters on the current output line
+        while (generator.next(piece)) {
+            if (plaintext) plaintext->write(piece.plaintext.data(), piece.plaintext.size());
+            recordBytes += piece.plaintext.size();
+
+            if (options.encoding == "raw") {
+                out.write(piece.ciphertext.data(), piece.ciphertext.size());
+            }
+            else {
+                std::string encoded = options.encoding == "hex" ? ascii2hex(piece.ciphertext) : ascii2base64(piece.ciphertext);
+                size_t pos = 0;
+                while (pos < encoded.size()) {
+                    size_t take = encoded.size() - pos;
+                    if (options.lineLength > 0) {
+                        if (column == options.lineLength) {
+                            out.put('\n');
+                            column = 0;
+                        }
+                        take = std::min(take, options.lineLength - column);
+                    }
+                    out.write(encoded.data() + pos, take);
+                    pos += take;
+                    column += take;
+                }
+                if (piece.lastOfRecord) {
+                    out.put('\n');
+                    column = 0;
+                }
+            }
+
+            if (piece.lastOfRecord) {
+                if (truth) *truth << piece.record << '\t' << piece.key.size() << '\t' << ascii2hex(piece.key) << '\t' << recordBytes << '\n';
+                recordBytes = 0;
+            }
+        }
+        out.flush();
+        if (!out) {
+            throw std::runtime_error("Error: Could not write corpus");
+        }
+    }
+    catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
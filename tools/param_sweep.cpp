@@ -0,0 +1,266 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "common_utils.h"
+#include "corpus_generator.h"
+#include "instrumentation.h"
+#include "xor_utils.h"
+
+// =======================
+// PARAMETER SWEEP TOOL
+// Runs XOR_findRepeatingKey over a generated corpus (see corpus_generator.h)
+// for every combination of breaker parameters in a grid and reports, per
+// configuration: share of records whose key was fully recovered, wall time
+// and bytes touched (input bytes read by all pipeline stages, from the
+// instrumentation counters).
+//
+// Configurations no other configuration beats on both recovery and time form
+// the Pareto frontier. The cheapest one reaching --target recovery is printed
+// at the end.
+//
+// Grid values are comma separated lists, e.g.
+//  param_sweep --records 50 --record-bytes 2K --key-lengths 2-40 --keysizes 1,2,3,5 --max-keysize 40,128
+//=======================
+
+namespace {
+
+    struct Grid {
+        std::vector<int> chi2threshold = { 20, 40, 80 };
+        std::vector<double> printableCharTreshhold = { 0.6, 0.7, 0.8 };
+        std::vector<int> noOfKeysizes = { 1, 3 };
+        std::vector<int> minKeysize = { 2 };
+        std::vector<int> maxKeysize = { 40, 128 };
+        std::vector<uint64_t> keysizeSample = { uint64_t{ 1 } << 22 };
+        std::vector<uint64_t> refinementBytes = { maxRefinementBytes };
+    };
+
+    struct Options {
+        CorpusSpec corpus;
+        uint64_t records = 40;
+        std::string sourceFile;
+        Grid grid;
+        double target = 0.95;
+        std::string jsonFile;
+    };
+
+    struct SweepResult {
+        BreakerParams params;
+        size_t recovered = 0;
+        size_t records = 0;
+        double seconds = 0;
+        uint64_t bytesTouched = 0;
+        bool pareto = false;
+
+        double recovery() const { return records ? static_cast<double>(recovered) / records : 0.0; }
+    };
+
+    // Comma separated list, integer items may be ranges ("2-40")
+    template <typename T, typename Parse>
+    std::vector<T> parseList(const std::string& text, Parse parse) {
+        std::vector<T> values;
+        size_t start = 0;
+        while (start <= text.size()) {
+            size_t end = text.find(',', start);
+            if (end == std::string::npos) end = text.size();
+            values.push_back(parse(text.substr(start, end - start)));
+            start = end + 1;
+        }
+        return values;
+    }
+
+    std::vector<int> parseIntList(const std::string& text) {
+        std::vector<int> values;
+        for (const std::string& item : parseList<std::string>(text, [](const std::string& s) { return s; })) {
+            size_t dash = item.find('-', 1);
+            if (dash == std::string::npos) {
+                values.push_back(std::stoi(item));
+            }
+            else {
+                for (int v = std::stoi(item.substr(0, dash)); v <= std::stoi(item.substr(dash + 1)); v++) values.push_back(v);
+            }
+        }
+        return values;
+    }
+
+    void usage(int exitCode) {
+        std::cout << "Usage: param_sweep [--seed 1] [--records 40] [--record-bytes 2K] [--key-lengths 2-40] [--source file.txt]\n"
+            "                   [--chi2 20,40,80] [--printable 0.6,0.7,0.8] [--keysizes 1,3]\n"
+            "                   [--min-keysize 2] [--max-keysize 40,128] [--keysize-sample 4M] [--refinement 1M]\n"
+            "                   [--target 0.95] [--json file]\n";
+        std::exit(exitCode);
+    }
+
+    Options parseOptions(int argc, char** argv) {
+        Options options;
+        options.corpus.recordBytes = 2048;
+        options.corpus.keyLengths = parseIntList("2-40");
+        for (int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+            auto value = [&]() -> std::string {
+                if (i + 1 >= argc) throw std::invalid_argument("Missing value for " + arg);
+                return argv[++i];
+            };
+            if (arg == "--seed") options.corpus.seed = std::stoull(value());
+            else if (arg == "--records") options.records = std::stoull(value());
+            else if (arg == "--record-bytes") options.corpus.recordBytes = parseSize(value());
+            else if (arg == "--key-lengths") options.corpus.keyLengths = parseIntList(value());
+            else if (arg == "--source") options.sourceFile = value();
+            else if (arg == "--chi2") options.grid.chi2threshold = parseIntList(value());
+            else if (arg == "--printable") options.grid.printableCharTreshhold = parseList<double>(value(), [](const std::string& s) { return std::stod(s); });
+            else if (arg == "--keysizes") options.grid.noOfKeysizes = parseIntList(value());
+            else if (arg == "--min-keysize") options.grid.minKeysize = parseIntList(value());
+            else if (arg == "--max-keysize") options.grid.maxKeysize = parseIntList(value());
+            else if (arg == "--keysize-sample") options.grid.keysizeSample = parseList<uint64_t>(value(), parseSize);
+            else if (arg == "--refinement") options.grid.refinementBytes = parseList<uint64_t>(value(), parseSize);
+            else if (arg == "--target") options.target = std::stod(value());
+            else if (arg == "--json") options.jsonFile = value();
+            else usage(arg == "--help" ? 0 : 1);
+        }
+        options.corpus.totalBytes = options.records * options.corpus.recordBytes;
+        return options;
+    }
+
+    // Every combination of grid values
+    std::vector<BreakerParams> gridConfigurations(const Grid& grid) {
+        std::vector<BreakerParams> configurations;
+        for (int chi2 : grid.chi2threshold)
+            for (double printable : grid.printableCharTreshhold)
+                for (int keysizes : grid.noOfKeysizes)
+                    for (int minKeysize : grid.minKeysize)
+                        for (int maxKeysize : grid.maxKeysize)
+                            for (uint64_t sample : grid.keysizeSample)
+                                for (uint64_t refinement : grid.refinementBytes) {
+                                    BreakerParams params;
+                                    params.chi2threshold = chi2;
+                                    params.printableCharTreshhold = printable;
+                                    params.noOfKeysizes = keysizes;
+                                    params.keysizeSearch.minKeysize = minKeysize;
+                                    params.keysizeSearch.maxKeysize = maxKeysize;
+                                    params.keysizeSearch.maxSampleSize = static_cast<size_t>(sample);
+                                    params.refinementBytes = static_cast<size_t>(refinement);
+                                    configurations.push_back(params);
+                                }
+        return configurations;
+    }
+
+    // Input bytes read by all breaking stages since the last reset
+    uint64_t bytesTouched() {
+        uint64_t bytes = 0;
+        for (Stage stage : { Stage::KeysizeDetection, Stage::Transposition, Stage::ColumnScoring, Stage::KeyRefinement, Stage::KeySelection }) {
+            bytes += stageCount(stage, StageCounter::Bytes);
+        }
+        return bytes;
+    }
+
+    // Marks results no other result beats on both recovery and time
+    void markParetoFrontier(std::vector<SweepResult>& results) {
+        for (SweepResult& candidate : results) {
+            candidate.pareto = std::none_of(results.begin(), results.end(), [&](const SweepResult& other) {
+                bool noWorse = other.recovered >= candidate.recovered && other.seconds <= candidate.seconds;
+                bool better = other.recovered > candidate.recovered || other.seconds < candidate.seconds;
+                return noWorse && better;
+                });
+        }
+    }
+
+    std::string describe(const BreakerParams& p) {
+        char text[200];
+        std::snprintf(text, sizeof(text), "chi2=%d printable=%.2f keysizes=%d range=%d-%d sample=%zu refinement=%zu",
+            p.chi2threshold, p.printableCharTreshhold, p.noOfKeysizes, p.keysizeSearch.minKeysize, p.keysizeSearch.maxKeysize,
+            p.keysizeSearch.maxSampleSize, p.refinementBytes);
+        return text;
+    }
+
+    void writeJson(const std::string& filename, const Options& options, const std::vector<SweepResult>& results) {
+        std::ofstream file(filename);
+        if (!file.is_open()) {
+            throw std::runtime_error("Error: Could not open file " + filename);
+        }
+        file << "{\"seed\":" << options.corpus.seed << ",\"records\":" << options.records << ",\"record_bytes\":" << options.corpus.recordBytes
+            << ",\"target\":" << options.target << ",\"results\":[";
+        for (size_t i = 0; i < results.size(); i++) {
+            const SweepResult& r = results[i];
+            const BreakerParams& p = r.params;
+            file << (i ? ",\n" : "\n") << "{\"chi2threshold\":" << p.chi2threshold << ",\"printable\":" << p.printableCharTreshhold
+                << ",\"keysizes\":" << p.noOfKeysizes << ",\"min_keysize\":" << p.keysizeSearch.minKeysize << ",\"max_keysize\":" << p.keysizeSearch.maxKeysize
+                << ",\"keysize_sample\":" << p.keysizeSearch.maxSampleSize << ",\"refinement_bytes\":" << p.refinementBytes
+                << ",\"recovered\":" << r.recovered << ",\"recovery\":" << r.recovery() << ",\"seconds\":" << r.seconds
+                << ",\"bytes_touched\":" << r.bytesTouched << ",\"pareto\":" << (r.pareto ? "true" : "false") << "}";
+        }
+        file << "\n]}\n";
+    }
+}
+
+
+int main(int argc, char** argv)
+{
+    try {
+        Options options = parseOptions(argc, argv);
+        std::string source = options.sourceFile.empty() ? std::string(englishSampleText()) : readFile(options.sourceFile);
+
+        // Whole records with their keys (records are kept in memory, size the corpus accordingly)
+        std::vector<std::string> ciphertexts;
+        std::vector<std::string> keys;
+        CorpusGenerator generator(options.corpus, source);
+        CorpusPiece piece;
+        while (generator.next(piece)) {
+            if (piece.offset == 0) {
+                ciphertexts.emplace_back();
+                keys.push_back(piece.key);
+            }
+            ciphertexts.back() += piece.ciphertext;
+        }
+
+        std::vector<SweepResult> results;
+        setInstrumentationEnabled(true);
+        for (const BreakerParams& params : gridConfigurations(options.grid)) {
+            SweepResult result;
+            result.params = params;
+            result.records = ciphertexts.size();
+            resetInstrumentation();
+            auto start = std::chrono::steady_clock::now();
+            for (size_t i = 0; i < ciphertexts.size(); i++) {
+                if (XOR_findRepeatingKey(ciphertexts[i], params).key == keys[i]) result.recovered++;
+            }
+            result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            result.bytesTouched = bytesTouched();
+            results.push_back(result);
+            std::printf("%6.1f%% %9.3fs %12llu B  %s\n", 100 * result.recovery(), result.seconds,
+                static_cast<unsigned long long>(result.bytesTouched), describe(params).c_str());
+            std::fflush(stdout);
+        }
+        setInstrumentationEnabled(false);
+
+        markParetoFrontier(results);
+        std::vector<SweepResult> frontier;
+        std::copy_if(results.begin(), results.end(), std::back_inserter(frontier), [](const SweepResult& r) { return r.pareto; });
+        std::sort(frontier.begin(), frontier.end(), [](const SweepResult& a, const SweepResult& b) { return a.seconds < b.seconds; });
+
+        std::printf("\nPareto frontier (recovery vs wall time):\n");
+        for (const SweepResult& r : frontier) {
+            std::printf("%6.1f%% %9.3fs %12llu B  %s\n", 100 * r.recovery(), r.seconds,
+                static_cast<unsigned long long>(r.bytesTouched), describe(r.params).c_str());
+        }
+        auto cheapest = std::find_if(frontier.begin(), frontier.end(), [&](const SweepResult& r) { return r.recovery() >= options.target; });
+        if (cheapest != frontier.end()) {
+            std::printf("\nCheapest configuration with recovery >= %.1f%%: %s\n", 100 * options.target, describe(cheapest->params).c_str());
+        }
+        else {
+            std::printf("\nNo configuration reaches recovery of %.1f%%\n", 100 * options.target);
+        }
+
+        if (!options.jsonFile.empty()) writeJson(options.jsonFile, options, results);
+    }
+    catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}